@@ -0,0 +1,137 @@
+/*
+  Button.cpp
+
+  See Button.h.
+*/
+
+#include "Button.h"
+
+#include "Hal.h"
+
+
+namespace Hal
+{
+
+void buttonInterrupt()
+{
+    Button.onEdge();
+}
+
+} // namespace Hal
+
+
+Button_::Button_()
+    : debounceMs(20)
+    , longPressMs(250)
+    , multiPressGapMs(0)
+    , edges_(0)
+    , firstEdgeMs_(0)
+    , lastEdgeMs_(0)
+    , bouncing_(false)
+    , bounceStartMs_(0)
+    , bounceEndMs_(0)
+    , down_(false)
+    , changeMs_(0)
+    , longPressReported_(false)
+    , presses_(0)
+{
+    // intentionally empty
+}
+
+void Button_::begin()
+{
+    down_ = Hal::buttonDown();
+    changeMs_ = Hal::millis();
+    longPressReported_ = down_;	// held since power-on, so no gesture
+    Hal::enableButtonInterrupt();
+}
+
+void Button_::onEdge()
+{
+    unsigned long const now = Hal::millis();
+    if (0 == edges_)
+    {
+        firstEdgeMs_ = now;
+    }
+    lastEdgeMs_ = now;
+    if (0xff != edges_)
+    {
+        ++edges_;
+    }
+}
+
+Button_::Event Button_::update(unsigned long nowMs)
+{
+    {
+        Hal::InterruptLock lock;
+        if (0 != edges_)
+        {
+            if (!bouncing_)
+            {
+                bouncing_ = true;
+                bounceStartMs_ = firstEdgeMs_;
+            }
+            bounceEndMs_ = lastEdgeMs_;
+            edges_ = 0;
+        }
+    }
+
+    if (bouncing_ && (debounceMs <= (nowMs - bounceEndMs_)))
+    {
+        // The pin settled, so its level is what counts.
+        bouncing_ = false;
+        bool const down = Hal::buttonDown();
+        if (down != down_)
+        {
+            down_ = down;
+            changeMs_ = bounceStartMs_;
+            if (down_)
+            {
+                longPressReported_ = false;
+            }
+            else if (!longPressReported_)
+            {
+                ++presses_;
+                if (0 == multiPressGapMs)
+                {
+                    Event const event = {Gesture::shortPress, presses_};
+                    presses_ = 0;
+                    return event;
+                }
+            }
+        }
+    }
+
+    if (down_ && !longPressReported_ && (longPressMs <= (nowMs - changeMs_)))
+    {
+        longPressReported_ = true;
+        presses_ = 0;
+        return {Gesture::longPress, 1};
+    }
+
+    if (!down_ && !bouncing_ && (0 != presses_) && (multiPressGapMs <= (nowMs - changeMs_)))
+    {
+        Event const event = {Gesture::shortPress, presses_};
+        presses_ = 0;
+        return event;
+    }
+
+    return {Gesture::none, 0};
+}
+
+bool Button_::down() const
+{
+    return down_;
+}
+
+unsigned long Button_::lastChangeMs() const
+{
+    return changeMs_;
+}
+
+bool Button_::idle() const
+{
+    return !down_ && !bouncing_ && (0 == presses_) && (0 == edges_);
+}
+
+Button_ Button;
@@ -0,0 +1,84 @@
+/*
+  Button.h
+
+  Gestures of the button between MISO and GND, driven by its pin change
+  interrupt: the interrupt only timestamps edges, update() debounces them
+  and classifies
+
+    shortPress  count presses, each following the previous release within
+                multiPressGapMs [reported once the gap has passed, or right
+                at the release if multiPressGapMs is 0]
+    longPress   held down for longPressMs [reported while still held]
+
+  Nothing has to be polled in between: call update() after each wake-up
+  and check idle() to see whether it waits for an edge only, so deep
+  sleep [Hal::powerDown()] is fine.
+*/
+
+#ifndef BUTTON_h
+#define BUTTON_h
+
+#include <stdint.h>
+
+
+class Button_
+{
+public:
+    enum class Gesture : uint8_t
+    {
+        none,
+        shortPress,
+        longPress
+    };
+
+    struct Event
+    {
+        Gesture gesture;
+        uint8_t count; // presses for shortPress
+    };
+
+    Button_();
+
+    // Takes the current level and enables the pin change interrupt.
+    void begin();
+
+    // Processes the edges since the last call. Returns at most one gesture.
+    Event update(unsigned long nowMs);
+
+    // Debounced state.
+    bool down() const;
+    // Time of the last debounced change.
+    unsigned long lastChangeMs() const;
+    // Returns true if nothing happens until the next edge.
+    bool idle() const;
+
+    // Called from the pin change interrupt - not meant to be called otherwise.
+    void onEdge();
+
+    // Edges within this time after the previous one are bounces.
+    unsigned long debounceMs;
+    unsigned long longPressMs;
+    // Zero reports each short press right at its release.
+    unsigned long multiPressGapMs;
+
+private:
+    Button_(Button_ const & other) = delete;
+    Button_ & operator=(Button_ const & other) = delete;
+
+    // Written by the interrupt.
+    uint8_t volatile edges_;
+    unsigned long volatile firstEdgeMs_;
+    unsigned long volatile lastEdgeMs_;
+
+    bool bouncing_;
+    unsigned long bounceStartMs_;
+    unsigned long bounceEndMs_;
+
+    bool down_;
+    unsigned long changeMs_;
+    bool longPressReported_;
+    uint8_t presses_;
+};
+extern Button_ Button;
+
+#endif
@@ -0,0 +1,191 @@
+/*
+  CompiledMessage.h
+
+  Turns a string literal into the exact sequence of key reports Keyboard_
+  would send for it - at compile time. The result can be placed in PROGMEM
+  and be replayed by Keyboard_::writeReports_P() without any per-character
+  table lookups:
+
+    static constexpr auto message PROGMEM =
+        KEYBOARD_COMPILE_MESSAGE(KeyboardLayout_de_DE, "Hello\n", CompiledMessage::Typing::pressRelease);
+
+    keyboard.writeReports_P(message.reports);
+
+  Characters the layout does not support are reported as compile errors
+  [mentioning unmappableCharacterInMessage()]. Besides the printing
+  characters, modifier and non-printing KEY_* codes may be embedded in the
+  text as well, e.g. "\xB0" for KEY_RETURN.
+
+  message.count and message.typingTimeUs() are constexpr, so the cost of a
+  message is known at build time.
+*/
+
+#ifndef COMPILED_MESSAGE_h
+#define COMPILED_MESSAGE_h
+
+#include "SlowKeyboard.h"
+#include "KeyboardLayout.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace CompiledMessage
+{
+
+enum class Typing : uint8_t
+{
+    pressRelease, // one report for pressing and one for releasing each character [like Keyboard_::write()]
+    rollover      // like Keyboard_::rolloverTyping
+};
+
+template <size_t N>
+struct Reports
+{
+    static size_t constexpr count = N;
+
+    // Time until the last report has been sent, if each one has to wait reportDelayUs.
+    static constexpr unsigned long typingTimeUs(unsigned long reportDelayUs = Keyboard_::defaultMinimumReportDelayUs)
+    {
+        return count * reportDelayUs;
+    }
+
+    KeyReport reports[N];
+};
+
+// Intentionally not defined - calling it from a constant expression fails compilation.
+void unmappableCharacterInMessage();
+
+namespace Detail
+{
+
+constexpr void addKey(KeyReport & report, uint8_t key)
+{
+    for (uint8_t i = 0; i < 6; ++i)
+    {
+        if (key == report.keys[i])
+        {
+            return;
+        }
+    }
+    for (uint8_t i = 0; i < 6; ++i)
+    {
+        if (0 == report.keys[i])
+        {
+            report.keys[i] = key;
+            return;
+        }
+    }
+}
+
+constexpr void removeKey(KeyReport & report, uint8_t key)
+{
+    for (uint8_t i = 0; i < 6; ++i)
+    {
+        if ((0 != key) && (key == report.keys[i]))
+        {
+            report.keys[i] = 0;
+        }
+    }
+}
+
+constexpr void emit(KeyReport const & report, KeyReport * reports, size_t & count)
+{
+    if (nullptr != reports)
+    {
+        reports[count] = report;
+    }
+    ++count;
+}
+
+// Simulates Keyboard_::write() for each character of text and stores the
+// resulting reports in reports [if not nullptr]. Returns the number of reports.
+template <size_t L>
+constexpr size_t compileInto(uint8_t const (&layout)[128], char const (&text)[L], Typing typing, KeyReport * reports)
+{
+    KeyReport report{};
+    uint8_t heldKey = 0;
+    uint8_t heldModifiers = 0;
+    size_t count = 0;
+
+    for (size_t i = 0; (i < L) && ('\0' != text[i]); ++i)
+    {
+        uint8_t const k = static_cast<uint8_t>(text[i]);
+        uint8_t key = 0;
+        uint8_t modifiers = 0;
+        if (!decodeLayoutKey(k, (k < 128) ? layout[k] : 0, key, modifiers))
+        {
+            unmappableCharacterInMessage();
+        }
+
+        bool const isModifier = (k >= 128) && (k < 136);
+        if ((Typing::pressRelease == typing) || isModifier || (key == heldKey))
+        {
+            if (0 != heldKey)
+            {
+                report.modifiers &= ~heldModifiers;
+                removeKey(report, heldKey);
+                heldKey = 0;
+                heldModifiers = 0;
+                emit(report, reports, count);
+            }
+        }
+        else
+        {
+            report.modifiers &= ~heldModifiers;
+            removeKey(report, heldKey);
+            heldKey = 0;
+            heldModifiers = 0;
+        }
+
+        report.modifiers |= modifiers;
+        addKey(report, key);
+        emit(report, reports, count);
+
+        if ((Typing::pressRelease == typing) || isModifier)
+        {
+            report.modifiers &= ~modifiers;
+            removeKey(report, key);
+            emit(report, reports, count);
+        }
+        else
+        {
+            heldKey = key;
+            heldModifiers = modifiers;
+        }
+    }
+
+    if (0 != heldKey)
+    {
+        report.modifiers &= ~heldModifiers;
+        removeKey(report, heldKey);
+        emit(report, reports, count);
+    }
+
+    return count;
+}
+
+} // namespace Detail
+
+template <size_t L>
+constexpr size_t reportCount(uint8_t const (&layout)[128], char const (&text)[L], Typing typing)
+{
+    return Detail::compileInto(layout, text, typing, nullptr);
+}
+
+template <size_t N, size_t L>
+constexpr Reports<N> compile(uint8_t const (&layout)[128], char const (&text)[L], Typing typing)
+{
+    Reports<N> result{};
+    Detail::compileInto(layout, text, typing, result.reports);
+    return result;
+}
+
+} // namespace CompiledMessage
+
+
+// Evaluates to a CompiledMessage::Reports<N> holding the reports for typing text with layout.
+#define KEYBOARD_COMPILE_MESSAGE(layout, text, typing) \
+    (CompiledMessage::compile<CompiledMessage::reportCount((layout), (text), (typing))>((layout), (text), (typing)))
+
+#endif
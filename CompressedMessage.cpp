@@ -0,0 +1,67 @@
+/*
+  CompressedMessage.cpp
+
+  Streaming decompressor for CompressedMessage.h.
+*/
+
+#include "CompressedMessage.h"
+
+
+namespace CompressedMessage
+{
+
+Reader::Reader(uint8_t const * compressed)
+    : next_(compressed)
+    , window_{}
+    , position_(0)
+    , flags_(0)
+    , flagsLeft_(0)
+    , matchDistance_(0)
+    , matchLeft_(0)
+    , end_(false)
+{
+    // intentionally empty
+}
+
+int Reader::read()
+{
+    uint8_t c;
+    if (0 != matchLeft_)
+    {
+        c = window_[(position_ - matchDistance_) & (windowSize - 1)];
+        --matchLeft_;
+    }
+    else
+    {
+        if (end_)
+        {
+            return -1;
+        }
+        if (0 == flagsLeft_)
+        {
+            flags_ = Hal::readFlashByte(next_++);
+            flagsLeft_ = 8;
+        }
+        bool const match = (0 != (flags_ & 0x01));
+        flags_ >>= 1;
+        --flagsLeft_;
+
+        c = Hal::readFlashByte(next_++);
+        if (match)
+        {
+            matchDistance_ = c >> 3;
+            if (0 == matchDistance_)
+            {
+                end_ = true;
+                return -1;
+            }
+            matchLeft_ = (c & 0x07) + minimumMatch - 1; // the first one is returned right away
+            c = window_[(position_ - matchDistance_) & (windowSize - 1)];
+        }
+    }
+    window_[position_ & (windowSize - 1)] = c;
+    ++position_;
+    return c;
+}
+
+} // namespace CompressedMessage
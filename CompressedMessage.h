@@ -0,0 +1,274 @@
+/*
+  CompressedMessage.h
+
+  Compresses string literals into a message store at compile time, so
+  many messages fit into flash, and decompresses them character by
+  character while typing:
+
+    static constexpr auto messages PROGMEM =
+        KEYBOARD_COMPRESS_MESSAGES("Hello\n", "Kind regards\n");
+
+    CompressedMessage::Reader reader(messages.message(1));
+    keyboard.writeFrom(reader);
+
+  KEYBOARD_COMPRESS_MESSAGES_FOR(layouts, unicodeTables, ...) also reports
+  characters which one of the layouts cannot type [with its unicode table]
+  as compile errors [mentioning unmappableCharacterInMessage()].
+
+  The format is LZSS with single byte tokens: each flag byte tells for
+  the next 8 tokens whether they are a literal byte or a match. A match
+  byte holds the distance [1 - 31, bits 7 - 3] back into the text typed
+  so far and the length minus 2 [2 - 9, bits 2 - 0]. Distance 0 ends the
+  message. So the Reader needs a RAM window of just 32 bytes, whereas
+  text compresses to roughly 60 - 90% of its size [repetitive boilerplate
+  much better] - compared to 16 bytes per character for CompiledMessage.h.
+*/
+
+#ifndef COMPRESSED_MESSAGE_h
+#define COMPRESSED_MESSAGE_h
+
+#include "Hal.h"
+#include "KeyboardLayout.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace CompressedMessage
+{
+
+static uint8_t constexpr windowSize = 32;
+static uint8_t constexpr maximumDistance = windowSize - 1;
+static uint8_t constexpr minimumMatch = 2;
+static uint8_t constexpr maximumMatch = minimumMatch + 7;
+
+template <size_t N, size_t M>
+struct Store
+{
+    static size_t constexpr size = N;
+    static size_t constexpr count = M;
+
+    // Returns the compressed message index for Reader. The store has to be
+    // in PROGMEM.
+    uint8_t const * message(size_t index) const
+    {
+        uint16_t offset;
+        Hal::readFlash(&offset, &offsets[index], sizeof(offset));
+        return data + offset;
+    }
+
+    uint16_t offsets[M];
+    uint8_t data[N];
+};
+
+// Decompresses a message from PROGMEM.
+class Reader
+{
+public:
+    explicit Reader(uint8_t const * compressed);
+
+    // Returns the next character or -1 at the end of the message.
+    int read();
+
+private:
+    uint8_t const * next_;
+    uint8_t window_[windowSize];
+    uint8_t position_;
+    uint8_t flags_;
+    uint8_t flagsLeft_;
+    uint8_t matchDistance_;
+    uint8_t matchLeft_;
+    bool end_;
+};
+
+// Intentionally not defined - calling it from a constant expression fails compilation.
+void unmappableCharacterInMessage();
+
+namespace Detail
+{
+
+constexpr void put(uint8_t * out, size_t position, uint8_t value)
+{
+    if (nullptr != out)
+    {
+        out[position] = value;
+    }
+}
+
+// Compresses text [up to its first '\0'] to out [if not nullptr] from
+// position on. Returns the position after it.
+template <size_t L>
+constexpr size_t compressInto(char const (&text)[L], uint8_t * out, size_t position)
+{
+    size_t length = 0;
+    while ((length < L) && ('\0' != text[length]))
+    {
+        ++length;
+    }
+
+    size_t flagsPosition = position;
+    uint8_t flags = 0;
+    uint8_t tokens = 0;
+    size_t i = 0;
+    bool end = false;
+    while (!end)
+    {
+        if (0 == tokens)
+        {
+            flagsPosition = position++;
+            flags = 0;
+        }
+
+        if (i == length)
+        {
+            flags |= (1 << tokens);
+            put(out, position++, 0);
+            end = true;
+        }
+        else
+        {
+            // Greedily take the longest match within the window.
+            size_t bestLength = 0;
+            size_t bestDistance = 0;
+            for (size_t distance = 1; (distance <= maximumDistance) && (distance <= i); ++distance)
+            {
+                size_t matchLength = 0;
+                while ((matchLength < maximumMatch) && (i + matchLength < length) &&
+                       (text[i + matchLength] == text[i + matchLength - distance]))
+                {
+                    ++matchLength;
+                }
+                if (matchLength > bestLength)
+                {
+                    bestLength = matchLength;
+                    bestDistance = distance;
+                }
+            }
+
+            if (bestLength >= minimumMatch)
+            {
+                flags |= (1 << tokens);
+                put(out, position++, static_cast<uint8_t>((bestDistance << 3) | (bestLength - minimumMatch)));
+                i += bestLength;
+            }
+            else
+            {
+                put(out, position++, static_cast<uint8_t>(text[i]));
+                ++i;
+            }
+        }
+
+        ++tokens;
+        if ((8 == tokens) || end)
+        {
+            put(out, flagsPosition, flags);
+            tokens = 0;
+        }
+    }
+    return position;
+}
+
+constexpr size_t compressAllInto(uint16_t * /*offsets*/, uint8_t * /*out*/, size_t position)
+{
+    return position;
+}
+
+template <size_t L, typename... Texts>
+constexpr size_t compressAllInto(uint16_t * offsets, uint8_t * out, size_t position,
+                                 char const (&text)[L], Texts const &... texts)
+{
+    if (nullptr != offsets)
+    {
+        *offsets = static_cast<uint16_t>(position);
+        ++offsets;
+    }
+    position = compressInto(text, out, position);
+    return compressAllInto(offsets, out, position, texts...);
+}
+
+// Fails compilation if neither layout nor the count unicodeKeys [e.g. dead
+// keys] can type c like Keyboard_::write().
+constexpr void checkCharacter(uint8_t const * layout, UnicodeKey const * unicodeKeys, size_t count, uint8_t c)
+{
+    uint8_t key = 0;
+    uint8_t modifiers = 0;
+    if (decodeLayoutKey(c, (c < 128) ? layout[c] : 0, key, modifiers))
+    {
+        return;
+    }
+    for (size_t i = 0; (c < 128) && (i < count); ++i)
+    {
+        if (c == unicodeKeys[i].codePoint)
+        {
+            return;
+        }
+    }
+    unmappableCharacterInMessage();
+}
+
+constexpr bool checkTexts(uint8_t const * /*layout*/, UnicodeKey const * /*unicodeKeys*/, size_t /*count*/)
+{
+    return true;
+}
+
+// Checks every character of the texts [up to their first '\0'].
+template <size_t L, typename... Texts>
+constexpr bool checkTexts(uint8_t const * layout, UnicodeKey const * unicodeKeys, size_t count,
+                          char const (&text)[L], Texts const &... texts)
+{
+    for (size_t i = 0; (i < L) && ('\0' != text[i]); ++i)
+    {
+        checkCharacter(layout, unicodeKeys, count, static_cast<uint8_t>(text[i]));
+    }
+    return checkTexts(layout, unicodeKeys, count, texts...);
+}
+
+} // namespace Detail
+
+// Checks the texts against each of layouts and the matching unicodeTables [with keys and count].
+template <size_t N, typename UnicodeTable, typename... Texts>
+constexpr bool checkTexts(uint8_t const * const (&layouts)[N], UnicodeTable const (&unicodeTables)[N], Texts const &... texts)
+{
+    for (size_t i = 0; i < N; ++i)
+    {
+        Detail::checkTexts(layouts[i], unicodeTables[i].keys, unicodeTables[i].count, texts...);
+    }
+    return true;
+}
+
+template <typename... Texts>
+constexpr size_t storeSize(Texts const &... texts)
+{
+    return Detail::compressAllInto(nullptr, nullptr, 0, texts...);
+}
+
+template <typename... Texts>
+constexpr size_t messageCount(Texts const &... /*texts*/)
+{
+    return sizeof...(Texts);
+}
+
+template <size_t N, size_t M, typename... Texts>
+constexpr Store<N, M> compressStore(Texts const &... texts)
+{
+    static_assert(N <= 0xffff, "message store too large");
+    Store<N, M> result{};
+    Detail::compressAllInto(result.offsets, result.data, 0, texts...);
+    return result;
+}
+
+} // namespace CompressedMessage
+
+
+// Evaluates to a CompressedMessage::Store holding all string literals given.
+#define KEYBOARD_COMPRESS_MESSAGES(...) \
+    (CompressedMessage::compressStore<CompressedMessage::storeSize(__VA_ARGS__), \
+                                      CompressedMessage::messageCount(__VA_ARGS__)>(__VA_ARGS__))
+
+// Like KEYBOARD_COMPRESS_MESSAGES, for string literals which every one of
+// layouts [an array of layout tables, with the matching array of unicode
+// tables] can type.
+#define KEYBOARD_COMPRESS_MESSAGES_FOR(layouts, unicodeTables, ...) \
+    (CompressedMessage::checkTexts((layouts), (unicodeTables), __VA_ARGS__), KEYBOARD_COMPRESS_MESSAGES(__VA_ARGS__))
+
+#endif
@@ -0,0 +1,246 @@
+/*
+  EepromMessages.cpp
+
+  See EepromMessages.h.
+*/
+
+#include "EepromMessages.h"
+
+#include "Hal.h"
+#include "MessageProtocol.h"
+
+
+EepromMessages::Reader::Reader()
+    : address_(0)
+    , left_(0)
+{
+    // intentionally empty
+}
+
+EepromMessages::Reader::Reader(size_t address, uint16_t length)
+    : address_(address)
+    , left_(length)
+{
+    // intentionally empty
+}
+
+int EepromMessages::Reader::read()
+{
+    if (0 == left_)
+    {
+        return -1;
+    }
+    --left_;
+    return Hal::readEeprom(address_++);
+}
+
+
+EepromMessages::EepromMessages(size_t begin, size_t end)
+    : begin_(begin)
+    , end_(end)
+    , writeRecord_(end)
+    , writeAddress_(end)
+    , writeId_(endId)
+    , writeCrc_(MessageProtocol::crcInitial)
+{
+    // intentionally empty
+}
+
+bool EepromMessages::find(uint8_t id, Reader & reader) const
+{
+    bool found = false;
+    // Take the last one, in case power failed before an older one got deleted.
+    for (size_t address = begin_; !atEnd_(address); address = next_(address))
+    {
+        Info const info = info_(address);
+        if (id == info.id)
+        {
+            reader = Reader(address + headerSize, info.length);
+            found = true;
+        }
+    }
+    return found;
+}
+
+uint16_t EepromMessages::idLimit() const
+{
+    uint16_t limit = 0;
+    forEach([&limit](Info const & info)
+    {
+        if (info.id >= limit)
+        {
+            limit = info.id + 1;
+        }
+    });
+    return limit;
+}
+
+uint16_t EepromMessages::freeBytes() const
+{
+    size_t used = 0;
+    forEach([&used](Info const & info)
+    {
+        used += headerSize + info.length;
+    });
+    size_t const available = end_ - begin_ - used;
+    return (available > headerSize) ? static_cast<uint16_t>(available - headerSize) : 0;
+}
+
+bool EepromMessages::remove(uint8_t id)
+{
+    bool found = false;
+    for (size_t address = begin_; !atEnd_(address); address = next_(address))
+    {
+        if (id == Hal::readEeprom(address))
+        {
+            Hal::updateEeprom(address, deletedId);
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool EepromMessages::beginWrite(uint8_t id, uint16_t length)
+{
+    if (maximumId < id)
+    {
+        return false;
+    }
+    if (freeBytes() < length)
+    {
+        // Only fits in place of the old message, so give up keeping that
+        // until the new one is complete.
+        uint16_t oldLength = 0;
+        forEach([id, &oldLength](Info const & info)
+        {
+            if (id == info.id)
+            {
+                oldLength += headerSize + info.length;
+            }
+        });
+        if (freeBytes() + oldLength < length)
+        {
+            return false;
+        }
+        remove(id);
+    }
+
+    size_t tail = tail_();
+    if (end_ - tail < headerSize + static_cast<size_t>(length))
+    {
+        compact_();
+        tail = tail_();
+    }
+
+    size_t const next = tail + headerSize + length;
+    if (next < end_)
+    {
+        Hal::updateEeprom(next, endId);
+    }
+    // The id stays endId until commitWrite().
+    Hal::updateEeprom(tail, endId);
+    Hal::updateEeprom(tail + 1, length & 0xff);
+    Hal::updateEeprom(tail + 2, length >> 8);
+
+    writeRecord_ = tail;
+    writeAddress_ = tail + headerSize;
+    writeId_ = id;
+    writeCrc_ = MessageProtocol::crcInitial;
+    return true;
+}
+
+void EepromMessages::writeByte(uint8_t value)
+{
+    if (writeAddress_ < end_)
+    {
+        Hal::updateEeprom(writeAddress_++, value);
+        writeCrc_ = MessageProtocol::crcUpdate(writeCrc_, value);
+    }
+}
+
+void EepromMessages::commitWrite()
+{
+    if (end_ <= writeRecord_)
+    {
+        return;
+    }
+    Hal::updateEeprom(writeRecord_ + 3, writeCrc_ & 0xff);
+    Hal::updateEeprom(writeRecord_ + 4, writeCrc_ >> 8);
+    // Valid first, then delete the older ones - a power failure in between
+    // leaves both, and find() takes the new one.
+    Hal::updateEeprom(writeRecord_, writeId_);
+    for (size_t address = begin_; address != writeRecord_; address = next_(address))
+    {
+        if (writeId_ == Hal::readEeprom(address))
+        {
+            Hal::updateEeprom(address, deletedId);
+        }
+    }
+    abortWrite();
+}
+
+void EepromMessages::abortWrite()
+{
+    writeRecord_ = end_;
+    writeAddress_ = end_;
+    writeId_ = endId;
+}
+
+// atEnd_() returns true at the end marker and where no valid record can start.
+bool EepromMessages::atEnd_(size_t address) const
+{
+    if ((address + headerSize > end_) || (endId == Hal::readEeprom(address)))
+    {
+        return true;
+    }
+    return (next_(address) > end_);	// garbage, e.g. from before the area was used for messages
+}
+
+size_t EepromMessages::next_(size_t address) const
+{
+    uint16_t const length = Hal::readEeprom(address + 1) | (static_cast<uint16_t>(Hal::readEeprom(address + 2)) << 8);
+    return address + headerSize + length;
+}
+
+EepromMessages::Info EepromMessages::info_(size_t address) const
+{
+    Info info;
+    info.id = Hal::readEeprom(address);
+    info.length = Hal::readEeprom(address + 1) | (static_cast<uint16_t>(Hal::readEeprom(address + 2)) << 8);
+    info.crc = Hal::readEeprom(address + 3) | (static_cast<uint16_t>(Hal::readEeprom(address + 4)) << 8);
+    return info;
+}
+
+size_t EepromMessages::tail_() const
+{
+    size_t address = begin_;
+    while (!atEnd_(address))
+    {
+        address = next_(address);
+    }
+    return address;
+}
+
+// compact_() moves all messages to the front, dropping deleted records.
+// Not power fail safe.
+void EepromMessages::compact_()
+{
+    size_t to = begin_;
+    for (size_t from = begin_; !atEnd_(from); )
+    {
+        size_t const next = next_(from);
+        if (maximumId >= Hal::readEeprom(from))
+        {
+            // to <= from, so copying forward never overwrites unread bytes.
+            for (size_t i = from; i < next; ++i, ++to)
+            {
+                Hal::updateEeprom(to, Hal::readEeprom(i));
+            }
+        }
+        from = next;
+    }
+    if (to < end_)
+    {
+        Hal::updateEeprom(to, endId);
+    }
+}
@@ -0,0 +1,107 @@
+/*
+  EepromMessages.h
+
+  Messages stored in an area of the EEPROM, so they can be changed at
+  runtime [see MessageUpload.h].
+
+  The area holds records one after the other, each a header of id,
+  length[2] and crc[2] of the text, followed by the text. An id of 0xff
+  marks the end [like erased EEPROM], 0xfe a deleted record. New records
+  are always appended and become valid by writing their id last [before
+  deleting the previous message], so an interrupted upload leaves the
+  previous message intact [unless the new one only fits in its place].
+  The space of deleted records is reclaimed by compacting once it is
+  needed.
+*/
+
+#ifndef EEPROM_MESSAGES_h
+#define EEPROM_MESSAGES_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+class EepromMessages
+{
+public:
+    // Reads a stored message byte by byte [see Keyboard_::writeFrom()].
+    class Reader
+    {
+    public:
+        Reader();
+        Reader(size_t address, uint16_t length);
+
+        // Returns the next byte or -1 at the end of the message.
+        int read();
+
+    private:
+        size_t address_;
+        uint16_t left_;
+    };
+
+    struct Info
+    {
+        uint8_t id;
+        uint16_t length;
+        uint16_t crc;
+    };
+
+    static uint8_t constexpr maximumId = 0xfd;
+    static uint8_t constexpr headerSize = 5;
+
+    // Uses the EEPROM from begin up to [excluding] end.
+    EepromMessages(size_t begin, size_t end);
+
+    bool find(uint8_t id, Reader & reader) const;
+
+    // Calls function(Info const &) for every stored message.
+    template <typename Function>
+    void forEach(Function function) const
+    {
+        for (size_t address = begin_; !atEnd_(address); address = next_(address))
+        {
+            Info const info = info_(address);
+            if (maximumId >= info.id)
+            {
+                function(info);
+            }
+        }
+    }
+
+    // Returns one past the highest id stored, 0 if there are no messages.
+    uint16_t idLimit() const;
+
+    // Returns the text bytes a single new message could have [after compacting].
+    uint16_t freeBytes() const;
+
+    // Deletes message id. Returns false if there was none.
+    bool remove(uint8_t id);
+
+    // Writing a message: beginWrite(), length times writeByte() and then
+    // commitWrite() to replace message id or abortWrite().
+    // beginWrite() returns false if the message does not fit.
+    bool beginWrite(uint8_t id, uint16_t length);
+    void writeByte(uint8_t value);
+    void commitWrite();
+    void abortWrite();
+
+private:
+    static uint8_t constexpr endId = 0xff;
+    static uint8_t constexpr deletedId = 0xfe;
+
+    bool atEnd_(size_t address) const;
+    size_t next_(size_t address) const;
+    Info info_(size_t address) const;
+    size_t tail_() const;
+    void compact_();
+
+    size_t const begin_;
+    size_t const end_;
+
+    size_t writeRecord_;
+    size_t writeAddress_;
+    uint8_t writeId_;
+    uint16_t writeCrc_;
+};
+
+#endif
@@ -0,0 +1,149 @@
+/*
+  Hal.h
+
+  Hardware abstraction used by Keyboard_ and main.cpp. Everything touching
+  the ATmega32u4, the Arduino USB core, flash, EEPROM or the pins goes
+  through these functions.
+
+  Hal_avr.cpp implements them for the Arduino Micro / Lily TTGO USB,
+  host/HalHost.cpp for the host build with a virtual clock and a mocked
+  USB host [see host/HalHost.h].
+*/
+
+#ifndef HAL_h
+#define HAL_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace Hal
+{
+
+// Time
+
+unsigned long micros();
+unsigned long millis();
+void delay(unsigned long ms);
+
+// Called while polling for a condition which will not change for about
+// maxUs. The AVR returns right away, keeping the busy wait exact, whereas
+// the host build advances its virtual clock.
+void pollDelay(unsigned long maxUs);
+
+// Sleeps [SLEEP_MODE_IDLE] until the next interrupt.
+void sleep();
+
+// Sleeps as deep as USB allows until the next interrupt: SLEEP_MODE_IDLE
+// while the bus is active, SLEEP_MODE_PWR_DOWN [with the USB clock frozen]
+// while it is suspended. Only the button, USB resume and the watchdog wake
+// it up then - the report timer and millis() stop.
+void powerDown();
+
+// Disables interrupts for its lifetime and restores them afterwards. Also
+// acts as a memory barrier.
+class InterruptLock
+{
+public:
+    InterruptLock();
+    ~InterruptLock();
+
+    InterruptLock(InterruptLock const & other) = delete;
+    InterruptLock & operator=(InterruptLock const & other) = delete;
+
+private:
+    uint8_t sreg_;
+};
+
+// Flash [PROGMEM]
+
+uint8_t readFlashByte(uint8_t const * address);
+void readFlash(void * destination, void const * source, size_t size);
+
+// EEPROM
+
+static size_t constexpr eepromSize = 1024;
+
+uint8_t readEeprom(size_t address);
+// Only writes if the value differs, like EEPROM.update() [taking about 3.4ms then].
+void updateEeprom(size_t address, uint8_t value);
+
+template <typename T>
+void getEeprom(size_t address, T & value)
+{
+    uint8_t * const bytes = reinterpret_cast<uint8_t *>(&value);
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        bytes[i] = readEeprom(address + i);
+    }
+}
+
+template <typename T>
+void putEeprom(size_t address, T const & value)
+{
+    uint8_t const * const bytes = reinterpret_cast<uint8_t const *>(&value);
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        updateEeprom(address + i, bytes[i]);
+    }
+}
+
+// Serial [the CDC port of the Arduino core]
+
+void beginSerial();
+// Returns the next byte received or -1 if there is none.
+int readSerial();
+void writeSerial(void const * data, size_t size);
+
+// Pins [button between MISO and GND, builtin LED]
+
+void initPins();
+bool buttonDown();
+void setLed(bool on);
+
+// Enables the pin change interrupt of the button, calling buttonInterrupt().
+void enableButtonInterrupt();
+
+// Implemented by the user of the button [Button.cpp], runs in interrupt context.
+void buttonInterrupt();
+
+// USB keyboard [the HID() interface of the Arduino core or KeyboardInterface]
+
+// descriptor has to be in PROGMEM and stay valid. May only be called once.
+void appendKeyboardDescriptor(uint8_t const * descriptor, uint16_t size);
+void sendKeyboardReport(uint8_t id, void const * data, uint8_t size);
+
+bool usbConfigured();
+// Returns true while the host suspended the bus [e.g. while it sleeps].
+bool usbSuspended();
+// Signals remote wakeup to the suspended host, which resumes the bus about
+// 20ms later. Returns false if the bus is not suspended or the host did not
+// enable remote wakeup [it may still resume on its own then].
+bool wakeupHost();
+// Returns true if the host selected the boot protocol for the keyboard.
+bool keyboardBootProtocol();
+// Returns the LEDs last set by the host [Num Lock 0x01, Caps Lock 0x02,
+// Scroll Lock 0x04, ...], always 0 with the shared HID() interface.
+uint8_t keyboardLeds();
+// Returns the 11-bit number of the current USB frame.
+uint16_t usbFrameNumber();
+// Returns true if the host has fetched everything from the HID IN endpoint.
+bool keyboardEndpointDrained();
+// Returns true if a report of size bytes [plus its id] fits into the HID IN
+// endpoint, so sendKeyboardReport() will not have to wait.
+bool keyboardEndpointWritable(uint8_t size);
+
+// Report timer [Timer3] for Keyboard_::asynchronous
+
+void startReportTimer();
+// Fires reportTimerInterrupt() delayUs after now [or the next tick for 0].
+void scheduleReportTimer(unsigned long delayUs);
+void stopReportTimer();
+bool reportTimerRunning();
+
+// Implemented by the user of the timer [SlowKeyboard.cpp], runs in interrupt context.
+void reportTimerInterrupt();
+
+} // namespace Hal
+
+#endif
@@ -0,0 +1,296 @@
+/*
+  Hal_avr.cpp
+
+  Hal.h for the ATmega32u4 with the Arduino core.
+*/
+
+#include "Hal.h"
+#include "KeyboardInterface.h"
+#include "SlowKeyboard.h"	// for the SLOW_KEYBOARD_* options
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <HID.h>
+
+#include <avr/pgmspace.h>
+#include <avr/sleep.h>
+
+
+namespace Pins
+{
+
+static uint8_t constexpr button = PIN_SPI_MISO; // PB3, PCINT3
+static uint8_t constexpr led = LED_BUILTIN;
+
+} // namespace Pins
+
+#if defined(SLOW_KEYBOARD_USB_INTERFACE)
+
+// Constructed by Keyboard_'s constructor, so before USBDevice.attach() in main().
+static KeyboardInterface & keyboardInterface()
+{
+    static KeyboardInterface interface(SLOW_KEYBOARD_USB_INTERFACE);
+    return interface;
+}
+
+static uint8_t keyboardEndpoint()
+{
+    return keyboardInterface().endpoint();
+}
+
+#else
+
+// HID() is the first and only PluggableUSB module, so it gets the first endpoint after CDC.
+static uint8_t constexpr keyboardEndpoint()
+{
+    return CDC_FIRST_ENDPOINT + CDC_ENPOINT_COUNT;
+}
+
+#endif
+
+
+ISR(PCINT0_vect)
+{
+    Hal::buttonInterrupt();
+}
+
+ISR(TIMER3_COMPA_vect)
+{
+    Hal::reportTimerInterrupt();
+}
+
+namespace Hal
+{
+
+unsigned long micros()
+{
+    return ::micros();
+}
+
+unsigned long millis()
+{
+    return ::millis();
+}
+
+void delay(unsigned long ms)
+{
+    ::delay(ms);
+}
+
+void pollDelay(unsigned long /*maxUs*/)
+{
+    // intentionally empty - keep busy waiting
+}
+
+void sleep()
+{
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_enable();
+    sleep_mode();
+    sleep_disable();
+}
+
+void powerDown()
+{
+    cli();
+    if (!USBDevice.isSuspended())
+    {
+        sei();
+        sleep();	// the USB controller needs its clock
+        return;
+    }
+
+    // WAKEUPI fires asynchronously on resume signalling. The USB clock and
+    // the PLL are left to the core: its USB_GEN_vect runs first after waking
+    // and clears WAKEUPI, which needs the clock unfrozen.
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sleep_enable();
+    sei();
+    sleep_cpu();	// sei() delays interrupts by one instruction, so none gets lost before sleeping
+    sleep_disable();
+}
+
+InterruptLock::InterruptLock()
+    : sreg_(SREG)
+{
+    cli();
+}
+
+InterruptLock::~InterruptLock()
+{
+    SREG = sreg_;
+}
+
+uint8_t readFlashByte(uint8_t const * address)
+{
+    return pgm_read_byte(address);
+}
+
+void readFlash(void * destination, void const * source, size_t size)
+{
+    memcpy_P(destination, source, size);
+}
+
+uint8_t readEeprom(size_t address)
+{
+    return EEPROM.read(address);
+}
+
+void updateEeprom(size_t address, uint8_t value)
+{
+    EEPROM.update(address, value);
+}
+
+void beginSerial()
+{
+    Serial.begin(115200);	// the baud rate does not matter for CDC
+}
+
+int readSerial()
+{
+    return Serial.read();
+}
+
+void writeSerial(void const * data, size_t size)
+{
+    Serial.write(static_cast<uint8_t const *>(data), size);
+}
+
+void initPins()
+{
+    static_assert(PIN_SPI_MISO == Pins::button); // Make sure we are talking about the same pin here and everywhere else.
+    PCMSK0 = (1<<PCINT3); // Enable pin change interrupt for PB3 [Arduino Pin PIN_SPI_MISO].
+    pinMode(Pins::button, INPUT_PULLUP);
+    pinMode(Pins::led, OUTPUT);
+}
+
+bool buttonDown()
+{
+    return (LOW == digitalRead(Pins::button));
+}
+
+void setLed(bool on)
+{
+    digitalWrite(Pins::led, on ? HIGH : LOW);
+}
+
+void enableButtonInterrupt()
+{
+    PCIFR = (1<<PCIF0); // Clear interrupt flag for PCINT7..0 of Atmega 32u4.
+    PCICR |= (1<<PCIE0); // Enable pin change interrupt for PCINT7..0 of Atmega 32u4.
+}
+
+void appendKeyboardDescriptor(uint8_t const * descriptor, uint16_t size)
+{
+#if defined(SLOW_KEYBOARD_USB_INTERFACE)
+    keyboardInterface().setDescriptor(descriptor, size);
+#else
+    static HIDSubDescriptor node(descriptor, size);
+    HID().AppendDescriptor(&node);
+#endif
+}
+
+void sendKeyboardReport(uint8_t id, void const * data, uint8_t size)
+{
+#if defined(SLOW_KEYBOARD_USB_INTERFACE)
+    keyboardInterface().sendReport(id, data, size);
+#else
+    HID().SendReport(id, data, size);
+#endif
+}
+
+bool usbConfigured()
+{
+    return USBDevice.configured();
+}
+
+bool usbSuspended()
+{
+    return USBDevice.isSuspended();
+}
+
+bool wakeupHost()
+{
+    return USBDevice.wakeupHost();
+}
+
+bool keyboardBootProtocol()
+{
+#if defined(SLOW_KEYBOARD_USB_INTERFACE)
+    return keyboardInterface().bootProtocol();
+#else
+    // The shared HID() interface is no boot interface, so the host cannot select it.
+    return false;
+#endif
+}
+
+uint8_t keyboardLeds()
+{
+#if defined(SLOW_KEYBOARD_USB_INTERFACE)
+    return keyboardInterface().leds();
+#else
+    // HID() has no output report and ignores SET_REPORT.
+    return 0;
+#endif
+}
+
+uint16_t usbFrameNumber()
+{
+    uint8_t high;
+    uint8_t low;
+    do {
+        high = UDFNUMH;
+        low = UDFNUML;
+    } while (high != UDFNUMH);	// the low byte overflowed in between
+    return (static_cast<uint16_t>(high & 0x07) << 8) | low;
+}
+
+bool keyboardEndpointDrained()
+{
+    InterruptLock lock;
+    uint8_t const previousEndpoint = UENUM;	// the USB interrupt may be using another endpoint
+    UENUM = keyboardEndpoint();
+    bool const drained = (0 == (UESTA0X & ((1<<NBUSYBK1) | (1<<NBUSYBK0))));
+    UENUM = previousEndpoint;
+    return drained;
+}
+
+bool keyboardEndpointWritable(uint8_t size)
+{
+    return (USB_SendSpace(keyboardEndpoint()) > size);
+}
+
+// Timer3 in CTC mode with clk/64 runs the asynchronous report queue.
+void scheduleReportTimer(unsigned long delayUs)
+{
+    unsigned long ticks = (delayUs * (F_CPU / 1000000ul)) / 64;
+    if (ticks < 1) {
+        ticks = 1;
+    } else if (ticks > 0xffff) {
+        ticks = 0xffff;	// just check again then
+    }
+    OCR3A = static_cast<uint16_t>(ticks);
+    TCNT3 = 0;
+}
+
+void startReportTimer()
+{
+    TCCR3A = 0;
+    scheduleReportTimer(0);
+    TIFR3 = (1<<OCF3A);
+    TIMSK3 = (1<<OCIE3A);
+    TCCR3B = (1<<WGM32) | (1<<CS31) | (1<<CS30);
+}
+
+void stopReportTimer()
+{
+    TCCR3B = 0;
+    TIMSK3 = 0;
+}
+
+bool reportTimerRunning()
+{
+    return (0 != TCCR3B);
+}
+
+} // namespace Hal
@@ -0,0 +1,146 @@
+/*
+  KeyboardInterface.cpp
+
+  See KeyboardInterface.h. Modelled on HID.cpp of the Arduino core.
+*/
+
+#include "KeyboardInterface.h"
+
+#include <Arduino.h>
+
+
+// wValueH of SET_REPORT for an output report.
+static uint8_t constexpr outputReportType = 2;
+
+
+KeyboardInterface::KeyboardInterface(uint8_t intervalMs)
+    : PluggableUSBModule(1, 1, endpointTypes_)
+    , intervalMs_(intervalMs)
+    , descriptor_(nullptr)
+    , descriptorSize_(0)
+    , protocol_(HID_REPORT_PROTOCOL)
+    , idle_(0)	// keyboards only send on changes by default
+    , leds_(0)
+{
+    endpointTypes_[0] = EP_TYPE_INTERRUPT_IN;
+    PluggableUSB().plug(this);
+}
+
+void KeyboardInterface::setDescriptor(uint8_t const * descriptor, uint16_t size)
+{
+    descriptor_ = descriptor;
+    descriptorSize_ = size;
+}
+
+void KeyboardInterface::sendReport(uint8_t id, void const * data, uint8_t size)
+{
+    // One transfer for id and report, so they always share a bank.
+    uint8_t buffer[1 + 16];
+    uint8_t length = 0;
+    if (!bootProtocol())
+    {
+        buffer[length++] = id;
+    }
+    if (size > sizeof(buffer) - length)
+    {
+        size = sizeof(buffer) - length;
+    }
+    memcpy(buffer + length, data, size);
+    USB_Send(pluggedEndpoint | TRANSFER_RELEASE, buffer, length + size);
+}
+
+bool KeyboardInterface::bootProtocol() const
+{
+    return (HID_BOOT_PROTOCOL == protocol_);
+}
+
+uint8_t KeyboardInterface::endpoint() const
+{
+    return pluggedEndpoint;
+}
+
+uint8_t KeyboardInterface::leds() const
+{
+    return leds_;
+}
+
+bool KeyboardInterface::setup(USBSetup & setup)
+{
+    if (pluggedInterface != setup.wIndex)
+    {
+        return false;
+    }
+
+    if (REQUEST_DEVICETOHOST_CLASS_INTERFACE == setup.bmRequestType)
+    {
+        switch (setup.bRequest)
+        {
+        case HID_GET_PROTOCOL:
+            USB_SendControl(0, &protocol_, 1);
+            return true;
+        case HID_GET_IDLE:
+            USB_SendControl(0, &idle_, 1);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    if (REQUEST_HOSTTODEVICE_CLASS_INTERFACE == setup.bmRequestType)
+    {
+        switch (setup.bRequest)
+        {
+        case HID_SET_PROTOCOL:
+            protocol_ = setup.wValueL;
+            return true;
+        case HID_SET_IDLE:
+            idle_ = setup.wValueH;	// the duration is in the high byte, the report id in the low one
+            return true;
+        case HID_SET_REPORT:
+            if ((outputReportType == setup.wValueH) && (0 < setup.wLength) && (setup.wLength <= 2))
+            {
+                // Report id and LEDs under report protocol, just the LEDs under boot protocol.
+                uint8_t data[2];
+                USB_RecvControl(data, setup.wLength);
+                leds_ = data[setup.wLength - 1];
+                return true;
+            }
+            return false;
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+int KeyboardInterface::getInterface(uint8_t * interfaceCount)
+{
+    *interfaceCount += 1;
+    HIDDescDescriptor const interface = {
+        D_INTERFACE(pluggedInterface, 1, USB_DEVICE_CLASS_HUMAN_INTERFACE, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_KEYBOARD),
+        D_HIDREPORT(descriptorSize_),
+        D_ENDPOINT(USB_ENDPOINT_IN(pluggedEndpoint), USB_ENDPOINT_TYPE_INTERRUPT, USB_EP_SIZE, intervalMs_)
+    };
+    return USB_SendControl(0, &interface, sizeof(interface));
+}
+
+int KeyboardInterface::getDescriptor(USBSetup & setup)
+{
+    if ((REQUEST_DEVICETOHOST_STANDARD_INTERFACE != setup.bmRequestType) ||
+        (HID_REPORT_DESCRIPTOR_TYPE != setup.wValueH) ||
+        (pluggedInterface != setup.wIndex))
+    {
+        return 0;
+    }
+    // A new enumeration starts in the report protocol.
+    protocol_ = HID_REPORT_PROTOCOL;
+    return USB_SendControl(TRANSFER_PGM, descriptor_, descriptorSize_);
+}
+
+uint8_t KeyboardInterface::getShortName(char * name)
+{
+    name[0] = 'K';
+    name[1] = 'B';
+    name[2] = 'D';
+    return 3;
+}
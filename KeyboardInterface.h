@@ -0,0 +1,61 @@
+/*
+  KeyboardInterface.h
+
+  USB interface of the keyboard alone, used instead of the shared HID()
+  interface of the Arduino core when built with SLOW_KEYBOARD_USB_INTERFACE
+  [see SlowKeyboard.h]. It has its own interrupt IN endpoint, which the
+  host polls every intervalMs [bInterval, down to 1ms at full speed], so
+  reports are limited by the USB frame rate rather than by the default
+  interval of HID().
+
+  The interface is a boot keyboard: the host may switch it to the boot
+  protocol with SET_PROTOCOL, which sendReport() follows by leaving out
+  the report id [see Hal::keyboardBootProtocol()]. It takes the LED output
+  report with SET_REPORT [see Hal::keyboardLeds()].
+
+  Only for the AVR - the host build models the USB host in HalHost.
+*/
+
+#ifndef KEYBOARD_INTERFACE_h
+#define KEYBOARD_INTERFACE_h
+
+#include <HID.h>
+#include <PluggableUSB.h>
+
+#include <stdint.h>
+
+
+class KeyboardInterface : public PluggableUSBModule
+{
+public:
+    // Plugs the interface into the USB core, so construct it before USBDevice.attach().
+    explicit KeyboardInterface(uint8_t intervalMs);
+
+    // descriptor has to be in PROGMEM and stay valid.
+    void setDescriptor(uint8_t const * descriptor, uint16_t size);
+
+    // Waits for room in the endpoint like HID().SendReport().
+    void sendReport(uint8_t id, void const * data, uint8_t size);
+
+    bool bootProtocol() const;
+    uint8_t endpoint() const;
+    // LEDs last set by the host.
+    uint8_t leds() const;
+
+protected:
+    bool setup(USBSetup & setup) override;
+    int getInterface(uint8_t * interfaceCount) override;
+    int getDescriptor(USBSetup & setup) override;
+    uint8_t getShortName(char * name) override;
+
+private:
+    EPTYPE_DESCRIPTOR_SIZE endpointTypes_[1];
+    uint8_t const intervalMs_;
+    uint8_t const * descriptor_;
+    uint16_t descriptorSize_;
+    uint8_t protocol_;
+    uint8_t idle_;
+    uint8_t volatile leds_;	// set from the USB interrupt
+};
+
+#endif
@@ -2,7 +2,7 @@
   KeyboardLayout.h
 
   This file is not part of the public API. It is meant to be included
-  only in Keyboard.cpp and the keyboard layout files. Layout files map
+  only in Keyboard.cpp and the keyboard layout headers. Layout files map
   ASCII character codes to keyboard scan codes (technically, to USB HID
   Usage codes), possibly altered by the SHIFT or ALT_GR modifiers.
 
@@ -23,6 +23,15 @@
   not use both SHIFT and ALT_GR on the same character: this is not
   supported. Unsupported characters should have 0x00 as scan code.
 
+  Characters beyond ASCII [and ASCII characters only available as dead
+  keys] go into a second array of UnicodeKey, sorted by code point. An
+  entry either names the key directly, encoded like the ASCII table, or a
+  dead key followed by the ASCII character to combine it with:
+
+      {0x00e4, 0x34,         0},    // ä
+      {0x00e2, 'a',          0x35}, // â = ^ then a
+      {0x005e, ' ',          0x35}, // ^ = ^ then space
+
   For a keyboard with an ISO physical layout, use the scan codes below:
 
       +---+---+---+---+---+---+---+---+---+---+---+---+---+-------+
@@ -40,10 +49,14 @@
   The ANSI layout is identical except that key 0x31 is above (rather
   than next to) Return, and there is not key 0x32.
 
-  Give a unique name to the layout array, then declare it in Keyboard.h
-  with a line of the form:
+  Give a unique name to the layout array, define it in its own header
+  KeyboardLayout_xx_YY.h in the form:
 
-    extern const uint8_t KeyboardLayout_xx_YY[];
+    inline constexpr uint8_t KeyboardLayout_xx_YY[128] PROGMEM = { ... };
+    inline constexpr UnicodeKey KeyboardLayout_xx_YY_unicode[] PROGMEM = { ... };
+
+  and include that header from Keyboard.h. Being constexpr, the table can
+  also be read at compile time [see CompiledMessage.h].
 
   == Encoding details ==
 
@@ -57,9 +70,65 @@
   the layout arrays.
 */
 
+#ifndef KEYBOARD_LAYOUT_h
+#define KEYBOARD_LAYOUT_h
+
 #include <Arduino.h>
 
 #define SHIFT 0x80
 #define ALT_GR 0xc0
 #define ISO_KEY 0x64
 #define ISO_REPLACEMENT 0x32
+
+// Translates k [a printing character, a modifier or a non-printing KEY_*
+// code] into the HID usage and the modifier bits needed to produce it.
+// entry is the layout table entry for k and is only used for printing
+// characters. Returns false if the layout does not support k.
+constexpr bool decodeLayoutKey(uint8_t k, uint8_t entry, uint8_t & key, uint8_t & modifiers)
+{
+    modifiers = 0;
+    if (k >= 136) {			// it's a non-printing key (not a modifier)
+        key = k - 136;
+    } else if (k >= 128) {	// it's a modifier key
+        modifiers = (1<<(k-128));
+        key = 0;
+    } else {				// it's a printing key
+        key = entry;
+        if (!key) {
+            return false;
+        }
+        if ((key & ALT_GR) == ALT_GR) {
+            modifiers = 0x40;   // AltGr = right Alt
+            key &= 0x3F;
+        } else if ((key & SHIFT) == SHIFT) {
+            modifiers = 0x02;	// the left shift modifier
+            key &= 0x7F;
+        }
+        if (key == ISO_REPLACEMENT) {
+            key = ISO_KEY;
+        }
+    }
+    return true;
+}
+
+// A character beyond the ASCII table [see "Creating your own layout"].
+typedef struct
+{
+    uint16_t codePoint;
+    uint8_t key;     // layout encoded key if deadKey is 0, otherwise an ASCII character
+    uint8_t deadKey; // layout encoded dead key or 0
+} UnicodeKey;
+
+// Unicode tables are searched by bisection, so they have to be sorted.
+template <size_t N>
+constexpr bool isSortedByCodePoint(UnicodeKey const (&keys)[N])
+{
+    for (size_t i = 1; i < N; ++i) {
+        if (keys[i].codePoint <= keys[i - 1].codePoint) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif
@@ -2,9 +2,12 @@
  * German keyboard layout.
  */
 
+#ifndef KEYBOARD_LAYOUT_DE_DE_h
+#define KEYBOARD_LAYOUT_DE_DE_h
+
 #include "KeyboardLayout.h"
 
-extern const uint8_t KeyboardLayout_de_DE[128] PROGMEM =
+inline constexpr uint8_t KeyboardLayout_de_DE[128] PROGMEM =
 {
     0x00,          // NUL
     0x00,          // SOH
@@ -136,3 +139,58 @@ extern const uint8_t KeyboardLayout_de_DE[128] PROGMEM =
     0x30|ALT_GR,   // ~
     0x00           // DEL
 };
+
+inline constexpr UnicodeKey KeyboardLayout_de_DE_unicode[] PROGMEM =
+{
+    {0x005e, ' ',           0x35},       // ^
+    {0x0060, ' ',           0x2e|SHIFT}, // `
+    {0x00a7, 0x20|SHIFT,    0},          // §
+    {0x00b0, 0x35|SHIFT,    0},          // °
+    {0x00b2, 0x1f|ALT_GR,   0},          // ²
+    {0x00b3, 0x20|ALT_GR,   0},          // ³
+    {0x00b4, ' ',           0x2e},       // ´
+    {0x00b5, 0x10|ALT_GR,   0},          // µ
+    {0x00c0, 'A',           0x2e|SHIFT}, // À
+    {0x00c1, 'A',           0x2e},       // Á
+    {0x00c2, 'A',           0x35},       // Â
+    {0x00c4, 0x34|SHIFT,    0},          // Ä
+    {0x00c8, 'E',           0x2e|SHIFT}, // È
+    {0x00c9, 'E',           0x2e},       // É
+    {0x00ca, 'E',           0x35},       // Ê
+    {0x00cc, 'I',           0x2e|SHIFT}, // Ì
+    {0x00cd, 'I',           0x2e},       // Í
+    {0x00ce, 'I',           0x35},       // Î
+    {0x00d2, 'O',           0x2e|SHIFT}, // Ò
+    {0x00d3, 'O',           0x2e},       // Ó
+    {0x00d4, 'O',           0x35},       // Ô
+    {0x00d6, 0x33|SHIFT,    0},          // Ö
+    {0x00d9, 'U',           0x2e|SHIFT}, // Ù
+    {0x00da, 'U',           0x2e},       // Ú
+    {0x00db, 'U',           0x35},       // Û
+    {0x00dc, 0x2f|SHIFT,    0},          // Ü
+    {0x00dd, 'Y',           0x2e},       // Ý
+    {0x00df, 0x2d,          0},          // ß
+    {0x00e0, 'a',           0x2e|SHIFT}, // à
+    {0x00e1, 'a',           0x2e},       // á
+    {0x00e2, 'a',           0x35},       // â
+    {0x00e4, 0x34,          0},          // ä
+    {0x00e8, 'e',           0x2e|SHIFT}, // è
+    {0x00e9, 'e',           0x2e},       // é
+    {0x00ea, 'e',           0x35},       // ê
+    {0x00ec, 'i',           0x2e|SHIFT}, // ì
+    {0x00ed, 'i',           0x2e},       // í
+    {0x00ee, 'i',           0x35},       // î
+    {0x00f2, 'o',           0x2e|SHIFT}, // ò
+    {0x00f3, 'o',           0x2e},       // ó
+    {0x00f4, 'o',           0x35},       // ô
+    {0x00f6, 0x33,          0},          // ö
+    {0x00f9, 'u',           0x2e|SHIFT}, // ù
+    {0x00fa, 'u',           0x2e},       // ú
+    {0x00fb, 'u',           0x35},       // û
+    {0x00fc, 0x2f,          0},          // ü
+    {0x00fd, 'y',           0x2e},       // ý
+    {0x20ac, 0x08|ALT_GR,   0}           // €
+};
+static_assert(isSortedByCodePoint(KeyboardLayout_de_DE_unicode), "sort by code point");
+
+#endif
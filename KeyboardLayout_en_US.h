@@ -2,9 +2,12 @@
  * Standard US keyboard layout.
  */
 
+#ifndef KEYBOARD_LAYOUT_EN_US_h
+#define KEYBOARD_LAYOUT_EN_US_h
+
 #include "KeyboardLayout.h"
 
-extern const uint8_t KeyboardLayout_en_US[128] PROGMEM =
+inline constexpr uint8_t KeyboardLayout_en_US[128] PROGMEM =
 {
 	0x00,          // NUL
 	0x00,          // SOH
@@ -136,3 +139,5 @@ extern const uint8_t KeyboardLayout_en_US[128] PROGMEM =
 	0x35|SHIFT,    // ~
 	0x00           // DEL
 };
+
+#endif
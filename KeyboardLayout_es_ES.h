@@ -0,0 +1,209 @@
+/*
+ * Spanish keyboard layout.
+ */
+
+#ifndef KEYBOARD_LAYOUT_ES_ES_h
+#define KEYBOARD_LAYOUT_ES_ES_h
+
+#include "KeyboardLayout.h"
+
+inline constexpr uint8_t KeyboardLayout_es_ES[128] PROGMEM =
+{
+	0x00,          // NUL
+	0x00,          // SOH
+	0x00,          // STX
+	0x00,          // ETX
+	0x00,          // EOT
+	0x00,          // ENQ
+	0x00,          // ACK
+	0x00,          // BEL
+	0x2a,          // BS  Backspace
+	0x2b,          // TAB Tab
+	0x28,          // LF  Enter
+	0x00,          // VT
+	0x00,          // FF
+	0x00,          // CR
+	0x00,          // SO
+	0x00,          // SI
+	0x00,          // DEL
+	0x00,          // DC1
+	0x00,          // DC2
+	0x00,          // DC3
+	0x00,          // DC4
+	0x00,          // NAK
+	0x00,          // SYN
+	0x00,          // ETB
+	0x00,          // CAN
+	0x00,          // EM
+	0x00,          // SUB
+	0x00,          // ESC
+	0x00,          // FS
+	0x00,          // GS
+	0x00,          // RS
+	0x00,          // US
+
+	0x2c,          // ' '
+	0x1e|SHIFT,    // !
+	0x1f|SHIFT,    // "
+	0x20|ALT_GR,   // #
+	0x21|SHIFT,    // $
+	0x22|SHIFT,    // %
+	0x23|SHIFT,    // &
+	0x2d,          // '
+	0x25|SHIFT,    // (
+	0x26|SHIFT,    // )
+	0x30|SHIFT,    // *
+	0x30,          // +
+	0x36,          // ,
+	0x38,          // -
+	0x37,          // .
+	0x24|SHIFT,    // /
+	0x27,          // 0
+	0x1e,          // 1
+	0x1f,          // 2
+	0x20,          // 3
+	0x21,          // 4
+	0x22,          // 5
+	0x23,          // 6
+	0x24,          // 7
+	0x25,          // 8
+	0x26,          // 9
+	0x37|SHIFT,    // :
+	0x36|SHIFT,    // ;
+	0x32,          // <
+	0x27|SHIFT,    // =
+	0x32|SHIFT,    // >
+	0x2d|SHIFT,    // ?
+	0x1f|ALT_GR,   // @
+	0x04|SHIFT,    // A
+	0x05|SHIFT,    // B
+	0x06|SHIFT,    // C
+	0x07|SHIFT,    // D
+	0x08|SHIFT,    // E
+	0x09|SHIFT,    // F
+	0x0a|SHIFT,    // G
+	0x0b|SHIFT,    // H
+	0x0c|SHIFT,    // I
+	0x0d|SHIFT,    // J
+	0x0e|SHIFT,    // K
+	0x0f|SHIFT,    // L
+	0x10|SHIFT,    // M
+	0x11|SHIFT,    // N
+	0x12|SHIFT,    // O
+	0x13|SHIFT,    // P
+	0x14|SHIFT,    // Q
+	0x15|SHIFT,    // R
+	0x16|SHIFT,    // S
+	0x17|SHIFT,    // T
+	0x18|SHIFT,    // U
+	0x19|SHIFT,    // V
+	0x1a|SHIFT,    // W
+	0x1b|SHIFT,    // X
+	0x1c|SHIFT,    // Y
+	0x1d|SHIFT,    // Z
+	0x2f|ALT_GR,   // [
+	0x35|ALT_GR,   // bslash
+	0x30|ALT_GR,   // ]
+	0x00,          // ^  not supported (requires dead key + space)
+	0x38|SHIFT,    // _
+	0x00,          // `  not supported (requires dead key + space)
+	0x04,          // a
+	0x05,          // b
+	0x06,          // c
+	0x07,          // d
+	0x08,          // e
+	0x09,          // f
+	0x0a,          // g
+	0x0b,          // h
+	0x0c,          // i
+	0x0d,          // j
+	0x0e,          // k
+	0x0f,          // l
+	0x10,          // m
+	0x11,          // n
+	0x12,          // o
+	0x13,          // p
+	0x14,          // q
+	0x15,          // r
+	0x16,          // s
+	0x17,          // t
+	0x18,          // u
+	0x19,          // v
+	0x1a,          // w
+	0x1b,          // x
+	0x1c,          // y
+	0x1d,          // z
+	0x34|ALT_GR,   // {
+	0x1e|ALT_GR,   // |
+	0x31|ALT_GR,   // }
+	0x00,          // ~  not supported (requires dead key + space)
+	0x00           // DEL
+};
+
+inline constexpr UnicodeKey KeyboardLayout_es_ES_unicode[] PROGMEM =
+{
+    {0x005e, ' ',           0x2f|SHIFT}, // ^
+    {0x0060, ' ',           0x2f},       // `
+    {0x007e, ' ',           0x21|ALT_GR}, // ~
+    {0x00a1, 0x2e,          0},          // ¡
+    {0x00a8, ' ',           0x34|SHIFT}, // ¨
+    {0x00aa, 0x35|SHIFT,    0},          // ª
+    {0x00ac, 0x23|ALT_GR,   0},          // ¬
+    {0x00b4, ' ',           0x34},       // ´
+    {0x00b7, 0x20|SHIFT,    0},          // ·
+    {0x00ba, 0x35,          0},          // º
+    {0x00bf, 0x2e|SHIFT,    0},          // ¿
+    {0x00c0, 'A',           0x2f},       // À
+    {0x00c1, 'A',           0x34},       // Á
+    {0x00c2, 'A',           0x2f|SHIFT}, // Â
+    {0x00c3, 'A',           0x21|ALT_GR}, // Ã
+    {0x00c4, 'A',           0x34|SHIFT}, // Ä
+    {0x00c7, 0x31|SHIFT,    0},          // Ç
+    {0x00c8, 'E',           0x2f},       // È
+    {0x00c9, 'E',           0x34},       // É
+    {0x00ca, 'E',           0x2f|SHIFT}, // Ê
+    {0x00cb, 'E',           0x34|SHIFT}, // Ë
+    {0x00cc, 'I',           0x2f},       // Ì
+    {0x00cd, 'I',           0x34},       // Í
+    {0x00ce, 'I',           0x2f|SHIFT}, // Î
+    {0x00cf, 'I',           0x34|SHIFT}, // Ï
+    {0x00d1, 0x33|SHIFT,    0},          // Ñ
+    {0x00d2, 'O',           0x2f},       // Ò
+    {0x00d3, 'O',           0x34},       // Ó
+    {0x00d4, 'O',           0x2f|SHIFT}, // Ô
+    {0x00d5, 'O',           0x21|ALT_GR}, // Õ
+    {0x00d6, 'O',           0x34|SHIFT}, // Ö
+    {0x00d9, 'U',           0x2f},       // Ù
+    {0x00da, 'U',           0x34},       // Ú
+    {0x00db, 'U',           0x2f|SHIFT}, // Û
+    {0x00dc, 'U',           0x34|SHIFT}, // Ü
+    {0x00e0, 'a',           0x2f},       // à
+    {0x00e1, 'a',           0x34},       // á
+    {0x00e2, 'a',           0x2f|SHIFT}, // â
+    {0x00e3, 'a',           0x21|ALT_GR}, // ã
+    {0x00e4, 'a',           0x34|SHIFT}, // ä
+    {0x00e7, 0x31,          0},          // ç
+    {0x00e8, 'e',           0x2f},       // è
+    {0x00e9, 'e',           0x34},       // é
+    {0x00ea, 'e',           0x2f|SHIFT}, // ê
+    {0x00eb, 'e',           0x34|SHIFT}, // ë
+    {0x00ec, 'i',           0x2f},       // ì
+    {0x00ed, 'i',           0x34},       // í
+    {0x00ee, 'i',           0x2f|SHIFT}, // î
+    {0x00ef, 'i',           0x34|SHIFT}, // ï
+    {0x00f1, 0x33,          0},          // ñ
+    {0x00f2, 'o',           0x2f},       // ò
+    {0x00f3, 'o',           0x34},       // ó
+    {0x00f4, 'o',           0x2f|SHIFT}, // ô
+    {0x00f5, 'o',           0x21|ALT_GR}, // õ
+    {0x00f6, 'o',           0x34|SHIFT}, // ö
+    {0x00f9, 'u',           0x2f},       // ù
+    {0x00fa, 'u',           0x34},       // ú
+    {0x00fb, 'u',           0x2f|SHIFT}, // û
+    {0x00fc, 'u',           0x34|SHIFT}, // ü
+    {0x00ff, 'y',           0x34|SHIFT}, // ÿ
+    {0x20ac, 0x08|ALT_GR,   0}           // €
+};
+static_assert(isSortedByCodePoint(KeyboardLayout_es_ES_unicode), "sort by code point");
+
+#endif
@@ -2,9 +2,12 @@
  * Traditional (not AFNOR) French keyboard layout.
  */
 
+#ifndef KEYBOARD_LAYOUT_FR_FR_h
+#define KEYBOARD_LAYOUT_FR_FR_h
+
 #include "KeyboardLayout.h"
 
-extern const uint8_t KeyboardLayout_fr_FR[128] PROGMEM =
+inline constexpr uint8_t KeyboardLayout_fr_FR[128] PROGMEM =
 {
 	0x00,          // NUL
 	0x00,          // SOH
@@ -136,3 +139,44 @@ extern const uint8_t KeyboardLayout_fr_FR[128] PROGMEM =
 	0x1f|ALT_GR,   // ~
 	0x00           // DEL
 };
+
+inline constexpr UnicodeKey KeyboardLayout_fr_FR_unicode[] PROGMEM =
+{
+    {0x00a3, 0x30|SHIFT,    0},          // £
+    {0x00a4, 0x30|ALT_GR,   0},          // ¤
+    {0x00a7, 0x38|SHIFT,    0},          // §
+    {0x00a8, ' ',           0x2f|SHIFT}, // ¨
+    {0x00b0, 0x2d|SHIFT,    0},          // °
+    {0x00b2, 0x35,          0},          // ²
+    {0x00b5, 0x31|SHIFT,    0},          // µ
+    {0x00c2, 'A',           0x2f},       // Â
+    {0x00c4, 'A',           0x2f|SHIFT}, // Ä
+    {0x00ca, 'E',           0x2f},       // Ê
+    {0x00cb, 'E',           0x2f|SHIFT}, // Ë
+    {0x00ce, 'I',           0x2f},       // Î
+    {0x00cf, 'I',           0x2f|SHIFT}, // Ï
+    {0x00d4, 'O',           0x2f},       // Ô
+    {0x00d6, 'O',           0x2f|SHIFT}, // Ö
+    {0x00db, 'U',           0x2f},       // Û
+    {0x00dc, 'U',           0x2f|SHIFT}, // Ü
+    {0x00e0, 0x27,          0},          // à
+    {0x00e2, 'a',           0x2f},       // â
+    {0x00e4, 'a',           0x2f|SHIFT}, // ä
+    {0x00e7, 0x26,          0},          // ç
+    {0x00e8, 0x24,          0},          // è
+    {0x00e9, 0x1f,          0},          // é
+    {0x00ea, 'e',           0x2f},       // ê
+    {0x00eb, 'e',           0x2f|SHIFT}, // ë
+    {0x00ee, 'i',           0x2f},       // î
+    {0x00ef, 'i',           0x2f|SHIFT}, // ï
+    {0x00f4, 'o',           0x2f},       // ô
+    {0x00f6, 'o',           0x2f|SHIFT}, // ö
+    {0x00f9, 0x34,          0},          // ù
+    {0x00fb, 'u',           0x2f},       // û
+    {0x00fc, 'u',           0x2f|SHIFT}, // ü
+    {0x00ff, 'y',           0x2f|SHIFT}, // ÿ
+    {0x20ac, 0x08|ALT_GR,   0}           // €
+};
+static_assert(isSortedByCodePoint(KeyboardLayout_fr_FR_unicode), "sort by code point");
+
+#endif
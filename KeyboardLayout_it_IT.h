@@ -2,9 +2,12 @@
  * Italian keyboard layout.
  */
 
+#ifndef KEYBOARD_LAYOUT_IT_IT_h
+#define KEYBOARD_LAYOUT_IT_IT_h
+
 #include "KeyboardLayout.h"
 
-extern const uint8_t KeyboardLayout_it_IT[128] PROGMEM =
+inline constexpr uint8_t KeyboardLayout_it_IT[128] PROGMEM =
 {
 	0x00,          // NUL
 	0x00,          // SOH
@@ -136,3 +139,21 @@ extern const uint8_t KeyboardLayout_it_IT[128] PROGMEM =
 	0x00,          // ~  not in this layout
 	0x00           // DEL
 };
+
+inline constexpr UnicodeKey KeyboardLayout_it_IT_unicode[] PROGMEM =
+{
+    {0x00a3, 0x20|SHIFT,    0},          // £
+    {0x00a7, 0x31|SHIFT,    0},          // §
+    {0x00b0, 0x34|SHIFT,    0},          // °
+    {0x00e0, 0x34,          0},          // à
+    {0x00e7, 0x33|SHIFT,    0},          // ç
+    {0x00e8, 0x2f,          0},          // è
+    {0x00e9, 0x2f|SHIFT,    0},          // é
+    {0x00ec, 0x2e,          0},          // ì
+    {0x00f2, 0x33,          0},          // ò
+    {0x00f9, 0x31,          0},          // ù
+    {0x20ac, 0x08|ALT_GR,   0}           // €
+};
+static_assert(isSortedByCodePoint(KeyboardLayout_it_IT_unicode), "sort by code point");
+
+#endif
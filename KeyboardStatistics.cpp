@@ -0,0 +1,66 @@
+/*
+  KeyboardStatistics.cpp
+
+  See KeyboardStatistics.h.
+*/
+
+#include "KeyboardStatistics.h"
+
+#include <string.h>
+
+
+void KeyboardStatistics::Histogram::reset()
+{
+    memset(counts, 0, sizeof(counts));
+    minUs = 0xffffffff;
+    maxUs = 0;
+}
+
+void KeyboardStatistics::Histogram::record(unsigned long us)
+{
+    uint8_t const index = bucket(us);
+    if (0xffff != counts[index])
+    {
+        ++counts[index];
+    }
+    if (bucketCount - 1 == index)
+    {
+        return;
+    }
+    if (us < minUs)
+    {
+        minUs = us;
+    }
+    if (us > maxUs)
+    {
+        maxUs = us;
+    }
+}
+
+void KeyboardStatistics::reset()
+{
+    waitUs.reset();
+    sendUs.reset();
+    intervalUs.reset();
+    reports = 0;
+    characters = 0;
+}
+
+uint8_t KeyboardStatistics::bucket(unsigned long us)
+{
+    if (us < bucketLowerUs(1))
+    {
+        return 0;
+    }
+    if (us >= bucketLowerUs(bucketCount - 1))
+    {
+        return bucketCount - 1;
+    }
+    // Octave from the highest bit set, half octave from the one below it.
+    uint8_t bits = 0;
+    for (unsigned long rest = us; 0 != rest; rest >>= 1)
+    {
+        ++bits;
+    }
+    return 1 + 2 * (bits - 6) + ((us >> (bits - 2)) & 1);
+}
@@ -0,0 +1,53 @@
+/*
+  KeyboardStatistics.h
+
+  Counters Keyboard_ keeps when built with SLOW_KEYBOARD_STATISTICS [see
+  SlowKeyboard.h]: how long sending a report waited for its time, how long
+  handing it to the USB core took and the actual interval between reports,
+  plus the number of reports and characters. Readable and resettable over
+  the serial port [see MessageProtocol.h], the layout is the same on the AVR
+  and the host [both little endian].
+
+  The histograms have two buckets per octave: bucket 0 counts values below
+  32us, bucket b from bucketLowerUs(b) up to bucketLowerUs(b + 1) and the
+  last one everything from 131ms on [e.g. the pauses between messages,
+  which are therefore left out of minUs and maxUs].
+*/
+
+#ifndef KEYBOARD_STATISTICS_h
+#define KEYBOARD_STATISTICS_h
+
+#include <stdint.h>
+
+
+struct KeyboardStatistics
+{
+    static uint8_t constexpr bucketCount = 26;
+
+    struct Histogram
+    {
+        uint16_t counts[bucketCount];   // saturating
+        uint32_t minUs;
+        uint32_t maxUs;
+
+        void reset();
+        void record(unsigned long us);
+    };
+
+    Histogram waitUs;       // until the report was due [or there was room in the queue when asynchronous]
+    Histogram sendUs;       // handing the report to the USB core
+    Histogram intervalUs;   // since the previous report
+    uint32_t reports;
+    uint32_t characters;    // typed by Keyboard_::write()
+
+    void reset();
+
+    static constexpr uint32_t bucketLowerUs(uint8_t bucket)
+    {
+        return (0 == bucket) ? 0 : (static_cast<uint32_t>(2 | ((bucket - 1) & 1)) << (4 + (bucket - 1) / 2));
+    }
+    static uint8_t bucket(unsigned long us);
+};
+static_assert(188 == sizeof(KeyboardStatistics), "KeyboardStatistics are sent as they are");
+
+#endif
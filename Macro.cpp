@@ -0,0 +1,167 @@
+/*
+  Macro.cpp
+
+  See Macro.h.
+*/
+
+#include "Macro.h"
+
+
+namespace Macro
+{
+
+Player::Player(Keyboard_ & keyboard)
+    : keyboard_(keyboard)
+    , reportDelayUs_(keyboard.minimumReportDelayUs)
+    , timing_(keyboard.timing)
+    , code_(0)
+    , operandsLeft_(0)
+    , operands_{}
+    , operandCount_(0)
+    , held_(0)
+{
+    // intentionally empty
+}
+
+bool Player::feed(uint8_t value)
+{
+    if (keyboard_.cancelled())
+    {
+        return false;
+    }
+    if (0 == code_)
+    {
+        switch (value)
+        {
+        case Code::press:
+        case Code::release:
+        case Code::chord:
+        case Code::delay:
+        case Code::reportDelay:
+        case Code::unicode:
+        case Code::timingProfile:
+            code_ = value;
+            operandsLeft_ = 1;
+            operandCount_ = 0;
+            return true;
+        case Code::releaseAll:
+            keyboard_.releaseAll();
+            held_ = 0;
+            return true;
+        case Code::defaultReportDelay:
+            keyboard_.minimumReportDelayUs = reportDelayUs_;
+            return true;
+        case '\r':
+            return true;    // not typed, like by Keyboard_::writeFrom()
+        default:
+            return (0 != keyboard_.write(value));
+        }
+    }
+
+    if (0 == value)
+    {
+        code_ = 0;
+        return false;
+    }
+    operands_[operandCount_++] = value;
+    if (1 == operandCount_)
+    {
+        // The first operand tells how many follow.
+        if (Code::chord == code_)
+        {
+            if (maximumChordKeys < value)
+            {
+                code_ = 0;
+                return false;
+            }
+            operandsLeft_ += value;
+        }
+        else if (Code::unicode == code_)
+        {
+            uint8_t const length = (value < 0x80) ? 1 : ((value < 0xc0) ? 0 : ((value < 0xe0) ? 2 : ((value < 0xf0) ? 3 : ((value < 0xf8) ? 4 : 0))));
+            if (0 == length)
+            {
+                code_ = 0;
+                return false;
+            }
+            operandsLeft_ += length - 1;
+        }
+    }
+    if (0 != --operandsLeft_)
+    {
+        return true;
+    }
+    bool const result = execute_();
+    code_ = 0;
+    return result;
+}
+
+void Player::finish()
+{
+    if (0 != held_)
+    {
+        keyboard_.releaseAll();
+        held_ = 0;
+    }
+    keyboard_.minimumReportDelayUs = reportDelayUs_;
+    keyboard_.timing = timing_;
+}
+
+// execute_() runs code_ once all its operands are there.
+bool Player::execute_()
+{
+    switch (code_)
+    {
+    case Code::press:
+        ++held_;
+        return (0 != keyboard_.press(operands_[0]));
+    case Code::release:
+        if (0 != held_)
+        {
+            --held_;
+        }
+        return (0 != keyboard_.release(operands_[0]));
+    case Code::chord:
+        for (uint8_t i = 1; i <= operands_[0]; ++i)
+        {
+            if (0 == keyboard_.press(operands_[i]))
+            {
+                keyboard_.releaseAll();
+                return false;
+            }
+        }
+        for (uint8_t i = operands_[0]; i >= 1; --i)
+        {
+            keyboard_.release(operands_[i]);
+        }
+        return true;
+    case Code::delay:
+        keyboard_.pause(operands_[0] * delayUnitMs);
+        return true;
+    case Code::reportDelay:
+        keyboard_.minimumReportDelayUs = operands_[0] * reportDelayUnitUs;
+        return true;
+    case Code::timingProfile:
+        keyboard_.timing = TimingProfiles::get(operands_[0] - 1);
+        if (0 != keyboard_.timing.reportDelayUs)
+        {
+            keyboard_.minimumReportDelayUs = keyboard_.timing.reportDelayUs;
+        }
+        return true;
+    case Code::unicode:
+    {
+        uint8_t const length = operandCount_;
+        uint32_t codePoint = operands_[0] & ((1 == length) ? 0x7f : (0x3f >> (length - 1)));
+        for (uint8_t i = 1; i < length; ++i)
+        {
+            codePoint = (codePoint << 6) | (operands_[i] & 0x3f);
+        }
+        return (0 != keyboard_.writeUnicode(codePoint));
+    }
+    default:
+        break;
+    }
+    return false;
+}
+
+} // namespace Macro
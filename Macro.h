@@ -0,0 +1,204 @@
+/*
+  Macro.h
+
+  Byte code for messages which do more than type text, interpreted by
+  Player while it is read [from a CompressedMessage::Reader, an
+  EepromMessages::Reader or any other source with int read()]:
+
+    byte         meaning
+    0x01 k       press k [a KEY_* code or an ASCII character, like press()]
+    0x02 k       release k
+    0x03         release all keys
+    0x04 n k...  chord: press the n keys in order, then release them in reverse
+    0x05 d       flush and wait d * 10ms [1 - 255, see Keyboard_::pause()]
+    0x06 r       report delay of r * 100us [1 - 255] until the end or 0x07
+    0x07         back to the report delay the macro started with
+    0x0c p       timing profile p - 1 [see TimingProfile.h] until the end,
+                 with its report delay if it has one
+    0x0b u...    one character by code point, given as UTF-8
+    otherwise    typed with write() like text [so KEY_* codes type that key]
+
+  No operand is 0, so macros are valid string literals and compress like
+  text - KEYBOARD_COMPRESS_MACROS compresses them [see CompressedMessage.h]
+  and reports keys which one of the given layouts cannot type as compile
+  errors [mentioning unmappableCharacterInMessage()]. Characters given by
+  code point are left to the unicode table or unicodeInput at runtime.
+  Plain text is a macro typing itself
+  [apart from the codes above, which type nothing anyway]. Text runs cost
+  a byte per character, special keys a byte each and chords 2 + n bytes.
+
+  host/assembleMacros turns a readable source into this code.
+*/
+
+#ifndef MACRO_h
+#define MACRO_h
+
+#include "CompressedMessage.h"
+#include "KeyboardLayout.h"
+#include "SlowKeyboard.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace Macro
+{
+
+namespace Code
+{
+
+static uint8_t constexpr press = 0x01;
+static uint8_t constexpr release = 0x02;
+static uint8_t constexpr releaseAll = 0x03;
+static uint8_t constexpr chord = 0x04;
+static uint8_t constexpr delay = 0x05;
+static uint8_t constexpr reportDelay = 0x06;
+static uint8_t constexpr defaultReportDelay = 0x07;
+static uint8_t constexpr unicode = 0x0b;
+static uint8_t constexpr timingProfile = 0x0c;
+
+} // namespace Code
+
+static uint8_t constexpr maximumChordKeys = 6;
+static unsigned long constexpr delayUnitMs = 10;
+static unsigned long constexpr reportDelayUnitUs = 100;
+
+class Player
+{
+public:
+    explicit Player(Keyboard_ & keyboard);
+
+    // Executes the next byte of the macro. Returns false if a key could
+    // not be typed, the code is invalid or the keyboard was cancelled,
+    // which ends the macro.
+    bool feed(uint8_t value);
+
+    // Releases what the macro left pressed and restores the report delay
+    // and timing.
+    void finish();
+
+private:
+    bool execute_();
+
+    Keyboard_ & keyboard_;
+    unsigned long const reportDelayUs_;
+    TimingProfile const timing_;
+
+    uint8_t code_;          // waiting for operands of it, 0 if none
+    uint8_t operandsLeft_;
+    uint8_t operands_[1 + maximumChordKeys];
+    uint8_t operandCount_;
+    uint8_t held_;          // keys pressed by 0x01 and not released yet
+};
+
+namespace Detail
+{
+
+template <size_t L>
+constexpr uint8_t at(char const (&code)[L], size_t index)
+{
+    return (index < L) ? static_cast<uint8_t>(code[index]) : 0;
+}
+
+// Fails compilation if layout cannot type k like Keyboard_::press().
+constexpr void checkKey(uint8_t const * layout, uint8_t k)
+{
+    uint8_t key = 0;
+    uint8_t modifiers = 0;
+    if (!decodeLayoutKey(k, (k < 128) ? layout[k] : 0, key, modifiers))
+    {
+        CompressedMessage::unmappableCharacterInMessage();
+    }
+}
+
+// Checks the keys of code [up to its first '\0'] against layout and its
+// unicodeTable [keys and count].
+template <typename UnicodeTable, size_t L>
+constexpr void checkLayout(uint8_t const * layout, UnicodeTable const & unicodeTable, char const (&code)[L])
+{
+    size_t i = 0;
+    while (0 != at(code, i))
+    {
+        uint8_t const value = at(code, i++);
+        switch (value)
+        {
+        case Code::press:
+        case Code::release:
+            checkKey(layout, at(code, i++));
+            break;
+        case Code::chord:
+            for (uint8_t n = at(code, i++); (0 < n) && (0 != at(code, i)); --n)
+            {
+                checkKey(layout, at(code, i++));
+            }
+            break;
+        case Code::delay:
+        case Code::reportDelay:
+        case Code::timingProfile:
+            ++i;
+            break;
+        case Code::unicode:
+            // Skip the lead byte and its continuation bytes.
+            for (++i; 0x80 == (at(code, i) & 0xc0); ++i)
+            {
+            }
+            break;
+        case Code::releaseAll:
+        case Code::defaultReportDelay:
+        case '\r':
+            break;
+        default:
+            CompressedMessage::Detail::checkCharacter(layout, unicodeTable.keys, unicodeTable.count, value);
+            break;
+        }
+    }
+}
+
+template <size_t N, typename UnicodeTable>
+constexpr bool checkLayouts(uint8_t const * const (&/*layouts*/)[N], UnicodeTable const (&/*unicodeTables*/)[N])
+{
+    return true;
+}
+
+template <size_t N, typename UnicodeTable, size_t L, typename... Codes>
+constexpr bool checkLayouts(uint8_t const * const (&layouts)[N], UnicodeTable const (&unicodeTables)[N],
+                            char const (&code)[L], Codes const &... codes)
+{
+    for (size_t i = 0; i < N; ++i)
+    {
+        checkLayout(layouts[i], unicodeTables[i], code);
+    }
+    return checkLayouts(layouts, unicodeTables, codes...);
+}
+
+} // namespace Detail
+
+// Plays the macro read from source. Returns the number of bytes executed.
+template <typename Source>
+size_t play(Keyboard_ & keyboard, Source & source)
+{
+    Player player(keyboard);
+    size_t n = 0;
+    int c;
+    while ((c = source.read()) >= 0)
+    {
+        if (!player.feed(static_cast<uint8_t>(c)))
+        {
+            break;
+        }
+        ++n;
+    }
+    player.finish();
+    return n;
+}
+
+} // namespace Macro
+
+
+// Evaluates to a CompressedMessage::Store holding all macros given, which
+// every one of layouts [an array of layout tables, with the matching array
+// of unicode tables] can type.
+#define KEYBOARD_COMPRESS_MACROS(layouts, unicodeTables, ...) \
+    (Macro::Detail::checkLayouts((layouts), (unicodeTables), __VA_ARGS__), KEYBOARD_COMPRESS_MESSAGES(__VA_ARGS__))
+
+#endif
@@ -0,0 +1,92 @@
+/*
+  MessageProtocol.h
+
+  Binary protocol for managing the messages and settings in EEPROM over
+  the CDC serial port - implemented by MessageUpload on the device and
+  spoken by host/uploadMessages.
+
+  Request:  sync command length[2] payload[length] crc[2]
+  Response: sync command status length[2] payload[length] crc[2]
+
+  Multi-byte values are little endian, crc is CRC-16/CCITT-FALSE over
+  everything after sync. A request is dropped if it pauses for more than
+  timeoutMs. Commands and their payloads:
+
+    list        request  -
+                response free[2], then per message id length[2] crc[2]
+    write       request  id text[length - 1], replaces message id [0 - 253]
+    remove      request  id
+    settings    request  -, or Settings [see Settings.h] to store them
+                response Settings as stored
+    statistics  request  -, or reset [non-zero to reset after reading]
+                response KeyboardStatistics [see KeyboardStatistics.h],
+                unknownCommand unless built with SLOW_KEYBOARD_STATISTICS
+    trace       request  -, or clear [non-zero to clear after reading]
+                response reportSize timeShift count, then count times
+                time[2] report[reportSize] oldest first [see ReportTrace.h],
+                unknownCommand unless built with SLOW_KEYBOARD_TRACE
+    cancel      request  -, stops the message being typed [see
+                Keyboard_::cancel()], ok even if there is none
+    type        request  text[length], typed while it arrives
+                response typed[2], the bytes typed before a cancel
+                [status cancelled] or a byte which cannot be typed
+
+  While a message is typed, only cancel is served - other requests are
+  answered with busy and have to be repeated.
+
+  The crc of a message in the list response is that of its text alone,
+  so the host can verify an upload without reading it back.
+*/
+
+#ifndef MESSAGE_PROTOCOL_h
+#define MESSAGE_PROTOCOL_h
+
+#include <stdint.h>
+
+
+namespace MessageProtocol
+{
+
+static uint8_t constexpr sync = 0xa5;
+
+enum class Command : uint8_t
+{
+    list = 'L',
+    write = 'W',
+    remove = 'D',
+    settings = 'S',
+    statistics = 'T',
+    trace = 'R',
+    cancel = 'C',
+    type = 'K'
+};
+
+enum class Status : uint8_t
+{
+    ok,
+    badChecksum,
+    unknownCommand,
+    badLength,
+    noSpace,
+    notFound,
+    busy,
+    cancelled
+};
+
+static unsigned long constexpr timeoutMs = 500;
+
+static uint16_t constexpr crcInitial = 0xffff;
+
+constexpr uint16_t crcUpdate(uint16_t crc, uint8_t value)
+{
+    crc ^= static_cast<uint16_t>(value) << 8;
+    for (uint8_t i = 0; i < 8; ++i)
+    {
+        crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+    }
+    return crc;
+}
+
+} // namespace MessageProtocol
+
+#endif
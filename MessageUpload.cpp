@@ -0,0 +1,379 @@
+/*
+  MessageUpload.cpp
+
+  See MessageUpload.h.
+*/
+
+#include "MessageUpload.h"
+
+#include "Hal.h"
+#include "SlowKeyboard.h"
+
+
+using MessageProtocol::Command;
+using MessageProtocol::Status;
+
+
+MessageUpload::MessageUpload(EepromMessages & messages, Settings & settings, SettingsStore & settingsStore)
+    : prepareKeyboard(nullptr)
+    , messages_(messages)
+    , settings_(settings)
+    , settingsStore_(settingsStore)
+    , state_(State::sync)
+    , command_(0)
+    , length_(0)
+    , received_(0)
+    , crc_(MessageProtocol::crcInitial)
+    , receivedCrcLow_(0)
+    , id_(0)
+    , typed_(0)
+    , receivedSettings_(settings)
+    , status_(Status::ok)
+    , lastByteMs_(0)
+    , responseCrc_(MessageProtocol::crcInitial)
+    , typing_(false)
+    , typingRequest_(false)
+{
+    // intentionally empty
+}
+
+void MessageUpload::poll()
+{
+    if (busy() && (MessageProtocol::timeoutMs < (Hal::millis() - lastByteMs_)))
+    {
+        reset_();
+    }
+
+    int value;
+    while (readyForByte_() && (0 <= (value = Hal::readSerial())))
+    {
+        lastByteMs_ = Hal::millis();
+        receive_(static_cast<uint8_t>(value));
+    }
+}
+
+void MessageUpload::pollWhileTyping()
+{
+    if (busy() && !typingRequest_)
+    {
+        return;
+    }
+    typing_ = true;
+    poll();
+    typing_ = false;
+}
+
+bool MessageUpload::busy() const
+{
+    return (State::sync != state_);
+}
+
+// readyForByte_() returns false while the text of a type request would have
+// to wait for room in the report queue - the byte stays in the endpoint.
+bool MessageUpload::readyForByte_() const
+{
+    return (State::payload != state_) || (Command::type != static_cast<Command>(command_)) ||
+           (Status::ok != status_) || !Keyboard.asynchronous || (0 < Keyboard.availableForWrite());
+}
+
+void MessageUpload::receive_(uint8_t value)
+{
+    if ((State::sync != state_) && (State::crcLow != state_) && (State::crcHigh != state_))
+    {
+        crc_ = MessageProtocol::crcUpdate(crc_, value);
+    }
+
+    switch (state_)
+    {
+    case State::sync:
+        if (MessageProtocol::sync == value)
+        {
+            crc_ = MessageProtocol::crcInitial;
+            typingRequest_ = typing_;
+            state_ = State::command;
+        }
+        break;
+    case State::command:
+        command_ = value;
+        state_ = State::lengthLow;
+        break;
+    case State::lengthLow:
+        length_ = value;
+        state_ = State::lengthHigh;
+        break;
+    case State::lengthHigh:
+        length_ |= static_cast<uint16_t>(value) << 8;
+        received_ = 0;
+        id_ = 0;
+        status_ = Status::ok;
+        switch (static_cast<Command>(command_))
+        {
+        case Command::list:
+            status_ = (0 == length_) ? Status::ok : Status::badLength;
+            break;
+        case Command::write:
+            status_ = (0 < length_) ? Status::ok : Status::badLength;
+            break;
+        case Command::remove:
+            status_ = (1 == length_) ? Status::ok : Status::badLength;
+            break;
+        case Command::settings:
+            status_ = ((0 == length_) || (sizeof(Settings) == length_)) ? Status::ok : Status::badLength;
+            break;
+        case Command::statistics:
+#if defined(SLOW_KEYBOARD_STATISTICS)
+            status_ = (length_ <= 1) ? Status::ok : Status::badLength;
+#else
+            status_ = Status::unknownCommand;
+#endif
+            break;
+        case Command::trace:
+#if defined(SLOW_KEYBOARD_TRACE)
+            status_ = (length_ <= 1) ? Status::ok : Status::badLength;
+#else
+            status_ = Status::unknownCommand;
+#endif
+            break;
+        case Command::cancel:
+            status_ = (0 == length_) ? Status::ok : Status::badLength;
+            break;
+        case Command::type:
+            status_ = (0 < length_) ? Status::ok : Status::badLength;
+            break;
+        default:
+            status_ = Status::unknownCommand;
+            break;
+        }
+        if (typingRequest_ && (Status::ok == status_) && (Command::cancel != static_cast<Command>(command_)))
+        {
+            status_ = Status::busy;
+        }
+        if ((Command::type == static_cast<Command>(command_)) && (Status::ok == status_))
+        {
+            typed_ = 0;
+            if (nullptr != prepareKeyboard)
+            {
+                prepareKeyboard();
+            }
+        }
+        state_ = (0 < length_) ? State::payload : State::crcLow;
+        break;
+    case State::payload:
+        payloadByte_(value);
+        if (++received_ == length_)
+        {
+            state_ = State::crcLow;
+        }
+        break;
+    case State::crcLow:
+        receivedCrcLow_ = value;
+        state_ = State::crcHigh;
+        break;
+    case State::crcHigh:
+        if (crc_ != (receivedCrcLow_ | (static_cast<uint16_t>(value) << 8)))
+        {
+            status_ = Status::badChecksum;
+        }
+        execute_();
+        reset_();
+        break;
+    }
+}
+
+void MessageUpload::payloadByte_(uint8_t value)
+{
+    if (Status::ok != status_)
+    {
+        return;	// just skip the payload
+    }
+    if (Command::settings == static_cast<Command>(command_))
+    {
+        reinterpret_cast<uint8_t *>(&receivedSettings_)[received_] = value;
+        return;
+    }
+    if (Command::type == static_cast<Command>(command_))
+    {
+        // Skips the rest once a byte was not typed, like Keyboard_::writeFrom().
+        if ((typed_ == received_) && (('\r' == value) || (0 != Keyboard.write(value))))
+        {
+            ++typed_;
+        }
+        return;
+    }
+    if (0 == received_)
+    {
+        id_ = value;
+        if ((Command::write == static_cast<Command>(command_)) && !messages_.beginWrite(id_, length_ - 1))
+        {
+            status_ = Status::noSpace;
+        }
+        return;
+    }
+    messages_.writeByte(value);
+}
+
+void MessageUpload::execute_()
+{
+    Command const command = static_cast<Command>(command_);
+    if (Status::ok != status_)
+    {
+        if (Command::write == command)
+        {
+            messages_.abortWrite();
+        }
+        beginResponse_(status_, 0);
+        endResponse_();
+        return;
+    }
+
+    switch (command)
+    {
+    case Command::list:
+    {
+        uint16_t length = 2;
+        messages_.forEach([&length](EepromMessages::Info const &)
+        {
+            length += 5;
+        });
+        beginResponse_(Status::ok, length);
+        uint16_t const free = messages_.freeBytes();
+        responseByte_(free & 0xff);
+        responseByte_(free >> 8);
+        messages_.forEach([this](EepromMessages::Info const & info)
+        {
+            responseByte_(info.id);
+            responseByte_(info.length & 0xff);
+            responseByte_(info.length >> 8);
+            responseByte_(info.crc & 0xff);
+            responseByte_(info.crc >> 8);
+        });
+        endResponse_();
+        break;
+    }
+    case Command::write:
+        messages_.commitWrite();
+        beginResponse_(Status::ok, 0);
+        endResponse_();
+        break;
+    case Command::remove:
+        beginResponse_(messages_.remove(id_) ? Status::ok : Status::notFound, 0);
+        endResponse_();
+        break;
+    case Command::settings:
+        if (sizeof(Settings) == length_)
+        {
+            settings_ = receivedSettings_;
+            settingsStore_.save(&settings_);
+        }
+        beginResponse_(Status::ok, sizeof(Settings));
+        for (uint8_t i = 0; i < sizeof(Settings); ++i)
+        {
+            responseByte_(reinterpret_cast<uint8_t const *>(&settings_)[i]);
+        }
+        endResponse_();
+        break;
+    case Command::statistics:
+#if defined(SLOW_KEYBOARD_STATISTICS)
+    {
+        KeyboardStatistics statistics;
+        {
+            Hal::InterruptLock lock;
+            statistics = Keyboard.statistics;
+            if (0 != id_)
+            {
+                Keyboard.statistics.reset();
+            }
+        }
+        beginResponse_(Status::ok, sizeof(statistics));
+        for (uint8_t i = 0; i < sizeof(statistics); ++i)
+        {
+            responseByte_(reinterpret_cast<uint8_t const *>(&statistics)[i]);
+        }
+        endResponse_();
+    }
+#endif
+        break;
+    case Command::trace:
+#if defined(SLOW_KEYBOARD_TRACE)
+    {
+        Keyboard.trace.paused = true;
+        uint8_t const count = Keyboard.trace.count();
+        uint8_t const reportSize = sizeof(Keyboard.trace.entries[0].report);
+        beginResponse_(Status::ok, 3 + count * (2 + reportSize));
+        responseByte_(reportSize);
+        responseByte_(Keyboard.trace.timeShift);
+        responseByte_(count);
+        for (uint8_t i = 0; i < count; ++i)
+        {
+            auto const & entry = Keyboard.trace.entry(i);
+            responseByte_(entry.time & 0xff);
+            responseByte_(entry.time >> 8);
+            for (uint8_t j = 0; j < reportSize; ++j)
+            {
+                responseByte_(reinterpret_cast<uint8_t const *>(&entry.report)[j]);
+            }
+        }
+        endResponse_();
+        if (0 != id_)
+        {
+            Keyboard.trace.clear();
+        }
+        Keyboard.trace.paused = false;
+    }
+#endif
+        break;
+    case Command::cancel:
+        Keyboard.cancel();
+        beginResponse_(Status::ok, 0);
+        endResponse_();
+        break;
+    case Command::type:
+        // Release what rolloverTyping still holds, the sender may stop here.
+        Keyboard.flush();
+        beginResponse_(Keyboard.cancelled() ? Status::cancelled : Status::ok, 2);
+        responseByte_(typed_ & 0xff);
+        responseByte_(typed_ >> 8);
+        endResponse_();
+        break;
+    }
+}
+
+void MessageUpload::reset_()
+{
+    if (State::payload <= state_)
+    {
+        messages_.abortWrite();	// no-op unless a write was interrupted
+        if (Command::type == static_cast<Command>(command_))
+        {
+            Keyboard.flush();	// no key stays down if the text broke off
+        }
+    }
+    state_ = State::sync;
+}
+
+void MessageUpload::beginResponse_(Status status, uint16_t length)
+{
+    uint8_t const header[] = {MessageProtocol::sync,
+                              command_,
+                              static_cast<uint8_t>(status),
+                              static_cast<uint8_t>(length & 0xff),
+                              static_cast<uint8_t>(length >> 8)};
+    Hal::writeSerial(header, 1);
+    responseCrc_ = MessageProtocol::crcInitial;
+    for (uint8_t i = 1; i < sizeof(header); ++i)
+    {
+        responseByte_(header[i]);
+    }
+}
+
+void MessageUpload::responseByte_(uint8_t value)
+{
+    responseCrc_ = MessageProtocol::crcUpdate(responseCrc_, value);
+    Hal::writeSerial(&value, 1);
+}
+
+void MessageUpload::endResponse_()
+{
+    uint8_t const crc[] = {static_cast<uint8_t>(responseCrc_ & 0xff), static_cast<uint8_t>(responseCrc_ >> 8)};
+    Hal::writeSerial(crc, sizeof(crc));
+}
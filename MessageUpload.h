@@ -0,0 +1,91 @@
+/*
+  MessageUpload.h
+
+  Serves MessageProtocol.h on the serial port: lists, writes and removes
+  the messages in EepromMessages, reads and writes the Settings and reads
+  the KeyboardStatistics and the ReportTrace of Keyboard.
+  Uploaded text goes into the EEPROM while it arrives, so no RAM buffer
+  of message size is needed. Until poll() reads them, further bytes stay
+  with the host [USB NAKs them], which paces the upload to the speed of
+  the EEPROM.
+  The text of a type request is streamed into Keyboard the same way: a
+  byte is only read once it can be typed, so the sender is held back to
+  the report pacing and nothing is dropped. With Keyboard.asynchronous,
+  the report queue is filled while the next bytes wait in the endpoint,
+  otherwise poll() types each byte before reading the next.
+*/
+
+#ifndef MESSAGE_UPLOAD_h
+#define MESSAGE_UPLOAD_h
+
+#include "EepromMessages.h"
+#include "MessageProtocol.h"
+#include "Settings.h"
+#include "SettingsStore.h"
+
+#include <stdint.h>
+
+
+class MessageUpload
+{
+public:
+    MessageUpload(EepromMessages & messages, Settings & settings, SettingsStore & settingsStore);
+
+    // Handles all bytes received so far. Call it regularly.
+    void poll();
+
+    // Like poll(), but while a message is being typed: requests beginning
+    // now are refused [see MessageProtocol.h] apart from cancel, requests
+    // begun before wait for poll().
+    void pollWhileTyping();
+
+    // Returns true while a request is being received.
+    bool busy() const;
+
+    // Called before typing the text of a type request [e.g. to apply the
+    // layout from the settings], nullptr for none.
+    void (*prepareKeyboard)(void);
+
+private:
+    enum class State : uint8_t
+    {
+        sync,
+        command,
+        lengthLow,
+        lengthHigh,
+        payload,
+        crcLow,
+        crcHigh
+    };
+
+    bool readyForByte_() const;
+    void receive_(uint8_t value);
+    void payloadByte_(uint8_t value);
+    void execute_();
+    void reset_();
+
+    void beginResponse_(MessageProtocol::Status status, uint16_t length);
+    void responseByte_(uint8_t value);
+    void endResponse_();
+
+    EepromMessages & messages_;
+    Settings & settings_;
+    SettingsStore & settingsStore_;
+
+    State state_;
+    uint8_t command_;
+    uint16_t length_;
+    uint16_t received_;
+    uint16_t crc_;
+    uint8_t receivedCrcLow_;
+    uint8_t id_;	// or the reset flag of statistics and trace
+    uint16_t typed_;	// by a type request
+    Settings receivedSettings_;
+    MessageProtocol::Status status_;
+    unsigned long lastByteMs_;
+    uint16_t responseCrc_;
+    bool typing_;
+    bool typingRequest_;	// began during pollWhileTyping()
+};
+
+#endif
@@ -0,0 +1,81 @@
+/*
+  ReportTrace.h
+
+  Circular buffer of the last Size reports Keyboard_ sent, each with a
+  16 bit time stamp in units of 1 << timeShift us [so it wraps after about
+  4.2s], kept when built with SLOW_KEYBOARD_TRACE [see SlowKeyboard.h].
+  Dumped over the serial port [see MessageProtocol.h] and decoded by
+  host/decodeTrace.
+
+  record() is meant to be cheap enough not to change the timing under
+  investigation: a shift, a copy of the report and an index increment.
+*/
+
+#ifndef REPORT_TRACE_h
+#define REPORT_TRACE_h
+
+#include <stdint.h>
+
+
+template <typename Report, uint8_t Size>
+struct ReportTrace
+{
+    static_assert((0 != Size) && (0 == (Size & (Size - 1))), "Size must be a power of 2");
+
+    static uint8_t constexpr timeShift = 6;
+
+    struct Entry
+    {
+        uint16_t time;
+        Report report;
+    };
+
+    Entry entries[Size];
+    uint8_t next;       // oldest entry once full
+    bool full;
+    // Set while dumping, so the entries do not change underneath.
+    bool volatile paused;
+
+    ReportTrace()
+        : next(0)
+        , full(false)
+        , paused(false)
+    {
+        // intentionally empty
+    }
+
+    void record(unsigned long nowUs, Report const & report)
+    {
+        if (paused)
+        {
+            return;
+        }
+        Entry & entry = entries[next];
+        entry.time = static_cast<uint16_t>(nowUs >> timeShift);
+        entry.report = report;
+        next = (next + 1) & (Size - 1);
+        if (0 == next)
+        {
+            full = true;
+        }
+    }
+
+    uint8_t count() const
+    {
+        return full ? Size : next;
+    }
+
+    // Returns the i-th oldest entry.
+    Entry const & entry(uint8_t i) const
+    {
+        return entries[(full ? (next + i) : i) & (Size - 1)];
+    }
+
+    void clear()
+    {
+        next = 0;
+        full = false;
+    }
+};
+
+#endif
@@ -0,0 +1,34 @@
+/*
+  Settings.h
+
+  Everything the device remembers besides its messages, kept in the
+  SettingsStore and readable and writable over the serial port [see
+  MessageProtocol.h]. The layout is the same on the AVR and the host [both
+  little endian], so the host tools send it as it is.
+*/
+
+#ifndef SETTINGS_h
+#define SETTINGS_h
+
+#include <stdint.h>
+
+
+struct Settings
+{
+    uint32_t messagesTyped;         // counter
+    uint16_t minimumReportDelayUs;  // Keyboard_::minimumReportDelayUs
+    uint8_t messageIndex;           // selected message
+    uint8_t layout;                 // 0 de_DE, 1 en_US, 2 es_ES, 3 fr_FR, 4 it_IT
+    uint8_t reportPacing;           // Keyboard_::ReportPacing
+    uint8_t framesPerReport;        // Keyboard_::framesPerReport
+    uint8_t rolloverTyping;         // Keyboard_::rolloverTyping
+    uint8_t unicodeInput;           // Keyboard_::UnicodeInput
+    uint8_t adaptiveRate;           // Keyboard_::adaptiveRate
+    uint8_t timingProfile;          // TimingProfiles::Name
+    uint8_t reserved[2];
+};
+static_assert(16 == sizeof(Settings), "Settings are sent and stored as they are");
+
+static constexpr Settings defaultSettings = {0, 16667, 0, 0, 0, 1, 0, 0, 0, 0, {0, 0}};
+
+#endif
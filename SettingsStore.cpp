@@ -0,0 +1,112 @@
+/*
+  SettingsStore.cpp
+
+  See SettingsStore.h.
+*/
+
+#include "SettingsStore.h"
+
+#include "Hal.h"
+#include "MessageProtocol.h"
+
+
+SettingsStore::SettingsStore(size_t begin, size_t end, uint8_t size)
+    : begin_(begin)
+    , size_(size)
+    , slots_((end - begin) / (size + overhead))
+    , loaded_(false)
+    , latestSlot_(0)
+    , latestSequence_(0)
+{
+    // intentionally empty
+}
+
+bool SettingsStore::load(void * data)
+{
+    loaded_ = false;
+    for (size_t slot = 0; slot < slots_; ++slot)
+    {
+        uint16_t sequence;
+        // Sequence numbers wrap, but all valid ones lie within slots_ of each other.
+        if (valid_(slot, sequence) && (!loaded_ || (0 < static_cast<int16_t>(sequence - latestSequence_))))
+        {
+            loaded_ = true;
+            latestSlot_ = slot;
+            latestSequence_ = sequence;
+        }
+    }
+    if (!loaded_)
+    {
+        latestSlot_ = slots_ - 1;	// the first save() goes to slot 0
+        return false;
+    }
+
+    uint8_t * const bytes = static_cast<uint8_t *>(data);
+    size_t const address = address_(latestSlot_) + 2;
+    for (uint8_t i = 0; i < size_; ++i)
+    {
+        bytes[i] = Hal::readEeprom(address + i);
+    }
+    return true;
+}
+
+void SettingsStore::save(void const * data)
+{
+    if (loaded_ && unchanged_(data))
+    {
+        return;
+    }
+
+    latestSlot_ = (latestSlot_ + 1) % slots_;
+    latestSequence_ = loaded_ ? (latestSequence_ + 1) : 0;
+    loaded_ = true;
+
+    uint8_t const * const bytes = static_cast<uint8_t const *>(data);
+    size_t const address = address_(latestSlot_);
+    uint8_t const sequence[] = {static_cast<uint8_t>(latestSequence_ & 0xff), static_cast<uint8_t>(latestSequence_ >> 8)};
+    uint16_t crc = MessageProtocol::crcInitial;
+    for (uint8_t i = 0; i < sizeof(sequence); ++i)
+    {
+        Hal::updateEeprom(address + i, sequence[i]);
+        crc = MessageProtocol::crcUpdate(crc, sequence[i]);
+    }
+    for (uint8_t i = 0; i < size_; ++i)
+    {
+        Hal::updateEeprom(address + 2 + i, bytes[i]);
+        crc = MessageProtocol::crcUpdate(crc, bytes[i]);
+    }
+    Hal::updateEeprom(address + 2 + size_, crc & 0xff);
+    Hal::updateEeprom(address + 3 + size_, crc >> 8);
+}
+
+bool SettingsStore::valid_(size_t slot, uint16_t & sequence) const
+{
+    size_t const address = address_(slot);
+    uint16_t crc = MessageProtocol::crcInitial;
+    for (uint8_t i = 0; i < size_ + 2; ++i)
+    {
+        crc = MessageProtocol::crcUpdate(crc, Hal::readEeprom(address + i));
+    }
+    uint16_t const stored = Hal::readEeprom(address + 2 + size_) | (static_cast<uint16_t>(Hal::readEeprom(address + 3 + size_)) << 8);
+    sequence = Hal::readEeprom(address) | (static_cast<uint16_t>(Hal::readEeprom(address + 1)) << 8);
+    return (stored == crc);
+}
+
+size_t SettingsStore::address_(size_t slot) const
+{
+    return begin_ + slot * (size_ + overhead);
+}
+
+bool SettingsStore::unchanged_(void const * data) const
+{
+    uint8_t const * const bytes = static_cast<uint8_t const *>(data);
+    size_t const address = address_(latestSlot_) + 2;
+    for (uint8_t i = 0; i < size_; ++i)
+    {
+        if (bytes[i] != Hal::readEeprom(address + i))
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,48 @@
+/*
+  SettingsStore.h
+
+  Keeps a small block of settings in an area of the EEPROM, spreading the
+  writes over the whole area: each save() goes into the next of its
+  fixed size slots as record of sequence[2], data and crc[2] [over both].
+  load() scans all slots once and takes the valid record with the newest
+  sequence number, so an interrupted save() leaves the previous settings.
+
+  With 20 byte records, the default 256 byte area multiplies the
+  endurance of a single EEPROM cell [100000 writes] by 12.
+*/
+
+#ifndef SETTINGS_STORE_h
+#define SETTINGS_STORE_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+class SettingsStore
+{
+public:
+    // Uses the EEPROM from begin up to [excluding] end for records of size data bytes.
+    SettingsStore(size_t begin, size_t end, uint8_t size);
+
+    // Returns false [leaving data untouched] if there is no valid record.
+    bool load(void * data);
+    // Does not write anything if data did not change since load() or save().
+    void save(void const * data);
+
+private:
+    static uint8_t constexpr overhead = 4;
+
+    bool valid_(size_t slot, uint16_t & sequence) const;
+    size_t address_(size_t slot) const;
+    bool unchanged_(void const * data) const;
+
+    size_t const begin_;
+    uint8_t const size_;
+    size_t const slots_;
+
+    bool loaded_;
+    size_t latestSlot_;
+    uint16_t latestSequence_;
+};
+
+#endif
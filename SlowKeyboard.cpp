@@ -20,6 +20,7 @@
 */
 
 #include "SlowKeyboard.h"
+#include "Hal.h"
 #include "KeyboardLayout.h"
 
 #include <Arduino.h>
@@ -60,67 +61,250 @@ static const uint8_t _hidReportDescriptor[] PROGMEM = {
     0x19, 0x00,                    //   USAGE_MINIMUM (Reserved (no event indicated))
     0x29, 0x73,                    //   USAGE_MAXIMUM (Keyboard Application)
     0x81, 0x00,                    //   INPUT (Data,Ary,Abs)
+#if defined(SLOW_KEYBOARD_USB_INTERFACE)
+    // LEDs for adaptiveRate, only KeyboardInterface takes SET_REPORT.
+    0x05, 0x08,                    //   USAGE_PAGE (LEDs)
+    0x19, 0x01,                    //   USAGE_MINIMUM (Num Lock)
+    0x29, 0x05,                    //   USAGE_MAXIMUM (Kana)
+    0x95, 0x05,                    //   REPORT_COUNT (5)
+    0x75, 0x01,                    //   REPORT_SIZE (1)
+
+    0x91, 0x02,                    //   OUTPUT (Data,Var,Abs)
+    0x95, 0x01,                    //   REPORT_COUNT (1)
+    0x75, 0x03,                    //   REPORT_SIZE (3)
+    0x91, 0x03,                    //   OUTPUT (Cnst,Var,Abs)
+#endif
+    0xc0,                          // END_COLLECTION
+
+#if defined(SLOW_KEYBOARD_NKRO)
+    //  N-key rollover keyboard
+    0x05, 0x01,                    // USAGE_PAGE (Generic Desktop)
+    0x09, 0x06,                    // USAGE (Keyboard)
+    0xa1, 0x01,                    // COLLECTION (Application)
+    0x85, 0x03,                    //   REPORT_ID (3)
+    0x05, 0x07,                    //   USAGE_PAGE (Keyboard)
+
+    0x19, 0xe0,                    //   USAGE_MINIMUM (Keyboard LeftControl)
+    0x29, 0xe7,                    //   USAGE_MAXIMUM (Keyboard Right GUI)
+    0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
+    0x25, 0x01,                    //   LOGICAL_MAXIMUM (1)
+    0x75, 0x01,                    //   REPORT_SIZE (1)
+
+    0x95, 0x08,                    //   REPORT_COUNT (8)
+    0x81, 0x02,                    //   INPUT (Data,Var,Abs)
+    0x19, 0x00,                    //   USAGE_MINIMUM (Reserved (no event indicated))
+    0x29, 0x77,                    //   USAGE_MAXIMUM (Keyboard Select)
+    0x95, 0x78,                    //   REPORT_COUNT (120)
+
+    0x81, 0x02,                    //   INPUT (Data,Var,Abs)
     0xc0,                          // END_COLLECTION
+#endif
 };
 
+namespace Hal
+{
+
+void reportTimerInterrupt()
+{
+    Keyboard.onReportTimer();
+}
+
+} // namespace Hal
+
 Keyboard_::Keyboard_(void)
-    : minimumReportDelayUs(16667ul)
-    , lastReportTimeUs_(micros() - 5000000ul) // assume at most 5s delay for now
+    : whileWaiting(nullptr)
+    , minimumReportDelayUs(defaultMinimumReportDelayUs)
+    , reportPacing(ReportPacing::fixedDelay)
+    , framesPerReport(1)
+    , timing()
+    , rolloverTyping(false)
+    , asynchronous(false)
+    , utf8(false)
+    , unicodeInput(UnicodeInput::none)
+    , adaptiveRate(false)
+    , adaptiveRateFloorUs(defaultAdaptiveRateFloorUs)
+    , adaptiveRateCeilingUs(defaultAdaptiveRateCeilingUs)
+    , adaptiveRateKey(KEY_CAPS_LOCK)
+    , lastReportTimeUs_(Hal::micros() - 5000000ul) // assume at most 5s delay for now
+    , lastReportFrame_(0)
+    , lastReport_()
+    , specialKeyReleased_(false)
+    , unicodeKeys_(nullptr)
+    , unicodeKeyCount_(0)
+    , utf8CodePoint_(0)
+    , utf8Remaining_(0)
+    , rolloverKey_(0)
+    , rolloverModifiers_(0)
+    , hostRoundTripUs_(0)
+    , lastCharacterMs_(0)
+    , charactersUntilRoundTrip_(0)
+    , hostLedsMissing_(false)
+    , reportQueueHead_(0)
+    , reportQueueTail_(0)
+    , cancelRequested_(false)
+    , cancelReleased_(false)
+    , measuringRoundTrip_(false)
 {
-    static HIDSubDescriptor node(_hidReportDescriptor, sizeof(_hidReportDescriptor));
-    HID().AppendDescriptor(&node);
+    Hal::appendKeyboardDescriptor(_hidReportDescriptor, sizeof(_hidReportDescriptor));
     _asciimap = KeyboardLayout_en_US;
+#if defined(SLOW_KEYBOARD_STATISTICS)
+    statistics.reset();
+#endif
 }
 
 void Keyboard_::begin(const uint8_t *layout)
+{
+    begin(layout, nullptr, 0);
+}
+
+void Keyboard_::begin(const uint8_t *layout, const UnicodeKey *unicodeKeys, uint8_t unicodeKeyCount)
 {
     _asciimap = layout;
+    unicodeKeys_ = unicodeKeys;
+    unicodeKeyCount_ = unicodeKeyCount;
+    charactersUntilRoundTrip_ = 0;	// measure at the first character, hostLedsMissing_ stays
+    if (cancelRequested_) {
+        // The host has seen all keys released, so start over from there.
+        memset(&_keyReport, 0, sizeof(_keyReport));
+        memset(&lastReport_, 0, sizeof(lastReport_));
+        specialKeyReleased_ = false;
+        rolloverKey_ = 0;
+        rolloverModifiers_ = 0;
+        utf8Remaining_ = 0;
+        cancelReleased_ = false;
+        cancelRequested_ = false;
+    }
 }
 
 void Keyboard_::end(void)
 {
+    flush();
 }
 
-void Keyboard_::sendReport(KeyReport* keys)
+void Keyboard_::sendReport(Report* keys)
 {
-    waitTillAndLogNextReportTime_();
-    HID().SendReport(2,keys,sizeof(KeyReport));
+    if (cancelReleased_) {
+        return;
+    }
+    bool settle;
+    uint16_t delayUs = timingDelayUs_(keys, settle);
+    if (settle) {
+        // The new modifiers alone first, the keys once they have settled.
+        Report modifiers = lastReport_;
+        modifiers.modifiers = keys->modifiers;
+        sendTimedReport_(&modifiers, delayUs);
+        delayUs = timing.modifierSettleUs;
+    }
+    lastReport_ = *keys;
+    sendTimedReport_(keys, delayUs);
 }
 
-uint8_t USBPutChar(uint8_t c);
-
-// press() adds the specified key (printing, non-printing, or modifier)
-// to the persistent key report and sends the report.  Because of the way
-// USB HID works, the host acts like the key remains pressed until we
-// call release(), releaseAll(), or otherwise clear the report and resend.
-size_t Keyboard_::press(uint8_t k)
+// sendTimedReport_() sends keys delayUs [or the pacing, whichever is later]
+// after the previous report, or queues it for that when asynchronous. Once
+// cancelled, the report releasing all keys goes out instead.
+void Keyboard_::sendTimedReport_(Report const * keys, uint16_t delayUs)
 {
-    uint8_t i;
-    if (k >= 136) {			// it's a non-printing key (not a modifier)
-        k = k - 136;
-    } else if (k >= 128) {	// it's a modifier key
-        _keyReport.modifiers |= (1<<(k-128));
-        k = 0;
-    } else {				// it's a printing key
-        k = pgm_read_byte(_asciimap + k);
-        if (!k) {
-            setWriteError();
-            return 0;
+    if (asynchronous) {
+        queueReport_(keys, delayUs);
+    } else {
+        waitForQueuedReports_();	// keep the order in case asynchronous was just cleared
+        if (cancelReleased_) {
+            return;
         }
-        if ((k & ALT_GR) == ALT_GR) {
-            _keyReport.modifiers |= 0x40;   // AltGr = right Alt
-            k &= 0x3F;
-        } else if ((k & SHIFT) == SHIFT) {
-            _keyReport.modifiers |= 0x02;	// the left shift modifier
-            k &= 0x7F;
+#if defined(SLOW_KEYBOARD_STATISTICS)
+        unsigned long const start = Hal::micros();
+#endif
+        unsigned long const now = waitTillNextReportTime_(delayUs);
+        Report const released = {};
+        if (cancelRequested_ && !measuringRoundTrip_) {
+            keys = &released;
+            cancelReleased_ = true;
         }
-        if (k == ISO_REPLACEMENT) {
-            k = ISO_KEY;
+        // keys is complete already, so send right at the deadline and do the bookkeeping afterwards.
+        sendReportNow_(keys);
+        logReport_(now);
+#if defined(SLOW_KEYBOARD_STATISTICS)
+        statistics.waitUs.record(now - start);
+#endif
+#if defined(SLOW_KEYBOARD_TRACE)
+        trace.record(now, *keys);
+#endif
+    }
+}
+
+// sendReportNow_() hands keys to the USB core, as 6-key array under boot protocol.
+void Keyboard_::sendReportNow_(Report const * keys)
+{
+#if defined(SLOW_KEYBOARD_STATISTICS)
+    unsigned long const start = Hal::micros();
+#endif
+#if defined(SLOW_KEYBOARD_NKRO)
+    if (!Hal::keyboardBootProtocol()) {
+        Hal::sendKeyboardReport(3,keys,sizeof(NkroReport));
+    } else {
+        // Report the first 6 keys or ErrorRollOver if there are more.
+        KeyReport boot = {keys->modifiers, 0, {0}};
+        uint8_t count = 0;
+        for (uint8_t k = 1; k < 8 * sizeof(keys->keys); k++) {
+            if (keys->keys[k >> 3] & (1 << (k & 7))) {
+                if (count == 6) {
+                    memset(boot.keys, 0x01, sizeof(boot.keys));
+                    break;
+                }
+                boot.keys[count++] = k;
+            }
         }
+        Hal::sendKeyboardReport(2,&boot,sizeof(KeyReport));
     }
+#else
+    Hal::sendKeyboardReport(2,keys,sizeof(KeyReport));
+#endif
+#if defined(SLOW_KEYBOARD_STATISTICS)
+    statistics.sendUs.record(Hal::micros() - start);
+#endif
+}
 
-    // Add k to the key report only if it's not already present
-    // and if there is an empty slot.
+uint8_t USBPutChar(uint8_t c);
+
+// decodeKey_() translates k [printing, non-printing or modifier key] into
+// the HID usage and the modifier bits needed to produce it. Returns false
+// if a printing key is not available in the current layout.
+bool Keyboard_::decodeKey_(uint8_t k, uint8_t & key, uint8_t & modifiers) const
+{
+    uint8_t const entry = (k < 128) ? Hal::readFlashByte(_asciimap + k) : 0;
+    return decodeLayoutKey(k, entry, key, modifiers);
+}
+
+#if defined(SLOW_KEYBOARD_NKRO)
+
+// addKey_() sets the bit of k in the key report. Returns false if k is
+// beyond the bitmap.
+bool Keyboard_::addKey_(uint8_t k)
+{
+    if (k >= 8 * sizeof(_keyReport.keys)) {
+        return false;
+    }
+    if (0 != k) {
+        _keyReport.keys[k >> 3] |= (1 << (k & 7));
+    }
+    return true;
+}
+
+// removeKey_() clears the bit of k in the key report.
+void Keyboard_::removeKey_(uint8_t k)
+{
+    if (0 != k && k < 8 * sizeof(_keyReport.keys)) {
+        _keyReport.keys[k >> 3] &= ~(1 << (k & 7));
+    }
+}
+
+#else
+
+// addKey_() puts k into an empty slot of the key report, unless it is
+// already present. Returns false if all 6 slots are in use.
+bool Keyboard_::addKey_(uint8_t k)
+{
+    uint8_t i;
     if (_keyReport.keys[0] != k && _keyReport.keys[1] != k &&
             _keyReport.keys[2] != k && _keyReport.keys[3] != k &&
             _keyReport.keys[4] != k && _keyReport.keys[5] != k) {
@@ -132,10 +316,46 @@ size_t Keyboard_::press(uint8_t k)
             }
         }
         if (i == 6) {
-            setWriteError();
-            return 0;
+            return false;
         }
     }
+    return true;
+}
+
+// removeKey_() clears k from the key report.
+// Check all positions in case the key is present more than once (which it shouldn't be)
+void Keyboard_::removeKey_(uint8_t k)
+{
+    uint8_t i;
+    for (i=0; i<6; i++) {
+        if (0 != k && _keyReport.keys[i] == k) {
+            _keyReport.keys[i] = 0x00;
+        }
+    }
+}
+
+#endif
+
+// press() adds the specified key (printing, non-printing, or modifier)
+// to the persistent key report and sends the report.  Because of the way
+// USB HID works, the host acts like the key remains pressed until we
+// call release(), releaseAll(), or otherwise clear the report and resend.
+size_t Keyboard_::press(uint8_t k)
+{
+    uint8_t modifiers;
+    releaseRolloverKey_();
+    if (!decodeKey_(k, k, modifiers)) {
+        setWriteError();
+        return 0;
+    }
+    _keyReport.modifiers |= modifiers;
+
+    // Add k to the key report only if it's not already present
+    // and if there is an empty slot.
+    if (!addKey_(k)) {
+        setWriteError();
+        return 0;
+    }
     sendReport(&_keyReport);
     return 1;
 }
@@ -145,36 +365,15 @@ size_t Keyboard_::press(uint8_t k)
 // it shouldn't be repeated any more.
 size_t Keyboard_::release(uint8_t k)
 {
-    uint8_t i;
-    if (k >= 136) {			// it's a non-printing key (not a modifier)
-        k = k - 136;
-    } else if (k >= 128) {	// it's a modifier key
-        _keyReport.modifiers &= ~(1<<(k-128));
-        k = 0;
-    } else {				// it's a printing key
-        k = pgm_read_byte(_asciimap + k);
-        if (!k) {
-            return 0;
-        }
-        if ((k & ALT_GR) == ALT_GR) {
-            _keyReport.modifiers &= ~(0x40);   // AltGr = right Alt
-            k &= 0x3F;
-        } else if ((k & SHIFT) == SHIFT) {
-            _keyReport.modifiers &= ~(0x02);	// the left shift modifier
-            k &= 0x7F;
-        }
-        if (k == ISO_REPLACEMENT) {
-            k = ISO_KEY;
-        }
+    uint8_t modifiers;
+    releaseRolloverKey_();
+    if (!decodeKey_(k, k, modifiers)) {
+        return 0;
     }
+    _keyReport.modifiers &= ~modifiers;
 
     // Test the key report to see if k is present.  Clear it if it exists.
-    // Check all positions in case the key is present more than once (which it shouldn't be)
-    for (i=0; i<6; i++) {
-        if (0 != k && _keyReport.keys[i] == k) {
-            _keyReport.keys[i] = 0x00;
-        }
-    }
+    removeKey_(k);
 
     sendReport(&_keyReport);
     return 1;
@@ -182,21 +381,74 @@ size_t Keyboard_::release(uint8_t k)
 
 void Keyboard_::releaseAll(void)
 {
-    _keyReport.keys[0] = 0;
-    _keyReport.keys[1] = 0;
-    _keyReport.keys[2] = 0;
-    _keyReport.keys[3] = 0;
-    _keyReport.keys[4] = 0;
-    _keyReport.keys[5] = 0;
+    memset(_keyReport.keys, 0, sizeof(_keyReport.keys));
     _keyReport.modifiers = 0;
+    rolloverKey_ = 0;
+    rolloverModifiers_ = 0;
     sendReport(&_keyReport);
 }
 
 size_t Keyboard_::write(uint8_t c)
 {
-    uint8_t p = press(c);	// Keydown
-    release(c);		// Keyup
-    return p;		// just return the result of press() since release() almost always returns 1
+    if (cancelRequested_) {
+        return 0;
+    }
+    if (utf8 && (c >= 0x80)) {
+        return writeUtf8Byte_(c);
+    }
+    utf8Remaining_ = 0;		// drop an incomplete UTF-8 sequence
+    if (adaptiveRate) {
+        adaptRate_();
+    }
+
+    if (c >= 128 && c < 136) {	// modifier keys are never pipelined
+        uint8_t p = press(c);	// Keydown
+        release(c);		// Keyup
+        return countCharacters_(p);	// just return the result of press() since release() almost always returns 1
+    }
+
+    uint8_t key;
+    uint8_t modifiers;
+    if (!decodeKey_(c, key, modifiers)) {
+        return writeUnicode(c);	// maybe a dead key or unicodeInput can produce it
+    }
+    return countCharacters_(typeKey_(key, modifiers));
+}
+
+// typeKey_() presses and releases key with modifiers. With rolloverTyping
+// the key stays down and is released together with pressing the next one.
+size_t Keyboard_::typeKey_(uint8_t key, uint8_t modifiers)
+{
+    if (key == rolloverKey_) {
+        // The same key [e.g. "ll" or "aA"] has to be released in a report of
+        // its own, otherwise the host would not see a second key press.
+        releaseRolloverKey_();
+    } else {
+        // Release the previous character in the same report as pressing this one.
+        _keyReport.modifiers &= ~rolloverModifiers_;
+        removeKey_(rolloverKey_);
+        rolloverKey_ = 0;
+        rolloverModifiers_ = 0;
+    }
+
+    _keyReport.modifiers |= modifiers;
+    if (!addKey_(key)) {
+        _keyReport.modifiers &= ~modifiers;
+        sendReport(&_keyReport);
+        setWriteError();
+        return 0;
+    }
+    sendReport(&_keyReport);
+
+    if (rolloverTyping) {
+        rolloverKey_ = key;
+        rolloverModifiers_ = modifiers;
+    } else {
+        _keyReport.modifiers &= ~modifiers;
+        removeKey_(key);
+        sendReport(&_keyReport);
+    }
+    return 1;
 }
 
 size_t Keyboard_::write(const uint8_t *buffer, size_t size) {
@@ -214,17 +466,592 @@ size_t Keyboard_::write(const uint8_t *buffer, size_t size) {
     return n;
 }
 
-void Keyboard_::waitTillAndLogNextReportTime_()
+size_t Keyboard_::write(const __FlashStringHelper *string)
+{
+    FlashReader reader(reinterpret_cast<const uint8_t *>(string), static_cast<size_t>(-1));
+    return writeFrom(reader);
+}
+
+size_t Keyboard_::write_P(const uint8_t *buffer, size_t size)
+{
+    FlashReader reader(buffer, size);
+    return writeFrom(reader);
+}
+
+Keyboard_::FlashReader::FlashReader(const uint8_t *next, size_t size)
+    : next_(next)
+    , left_(size)
+{
+}
+
+int Keyboard_::FlashReader::read()
+{
+    if (0 == left_) {
+        return -1;
+    }
+    --left_;
+    uint8_t const c = Hal::readFlashByte(next_++);
+    if (0 == c) {
+        left_ = 0;
+        return -1;
+    }
+    return c;
+}
+
+// writeUtf8Byte_() collects the bytes of a UTF-8 sequence and types the
+// character once it is complete.
+size_t Keyboard_::writeUtf8Byte_(uint8_t c)
+{
+    if (c < 0xc0) {			// continuation byte
+        if (0 == utf8Remaining_) {
+            setWriteError();
+            return 0;
+        }
+        utf8CodePoint_ = (utf8CodePoint_ << 6) | (c & 0x3f);
+        if (0 != --utf8Remaining_) {
+            return 1;
+        }
+        return writeUnicode(utf8CodePoint_);
+    }
+    if (c >= 0xf8) {
+        utf8Remaining_ = 0;
+        setWriteError();
+        return 0;
+    }
+    if (adaptiveRate) {
+        adaptRate_();		// before the lead byte, so between characters
+    }
+    utf8Remaining_ = (c >= 0xf0) ? 3 : ((c >= 0xe0) ? 2 : 1);
+    utf8CodePoint_ = c & (0x3f >> utf8Remaining_);
+    return 1;
+}
+
+// writeUnicode() types codePoint the cheapest way available: as key of the
+// layout, as dead key followed by a base character or by unicodeInput.
+size_t Keyboard_::writeUnicode(uint32_t codePoint)
+{
+    uint8_t key;
+    uint8_t modifiers;
+    if ((codePoint < 128) && decodeKey_(codePoint, key, modifiers)) {
+        return countCharacters_(typeKey_(key, modifiers));
+    }
+
+    UnicodeKey unicodeKey;
+    uint8_t layoutCost = unavailableCost;
+    if (findUnicodeKey_(codePoint, unicodeKey)) {
+        layoutCost = (0 != unicodeKey.deadKey) ? deadKeyCost : directKeyCost;
+    }
+    uint8_t const inputCost = unicodeInputCost_(codePoint);
+
+    if ((unavailableCost == layoutCost) && (unavailableCost == inputCost)) {
+        setWriteError();
+        return 0;
+    }
+    if (layoutCost <= inputCost) {
+        return countCharacters_(typeUnicodeKey_(unicodeKey));
+    }
+    return countCharacters_(typeUnicodeInput_(codePoint));
+}
+
+// findUnicodeKey_() bisects the unicode table of the layout.
+bool Keyboard_::findUnicodeKey_(uint32_t codePoint, UnicodeKey & unicodeKey) const
+{
+    uint8_t low = 0;
+    uint8_t high = unicodeKeyCount_;
+    while (low < high) {
+        uint8_t const middle = (low + high) / 2;
+        Hal::readFlash(&unicodeKey, unicodeKeys_ + middle, sizeof(UnicodeKey));
+        if (unicodeKey.codePoint == codePoint) {
+            return true;
+        }
+        if (unicodeKey.codePoint < codePoint) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return false;
+}
+
+// unicodeInputCost_() returns the number of reports unicodeInput needs for codePoint.
+uint8_t Keyboard_::unicodeInputCost_(uint32_t codePoint) const
+{
+    uint8_t digits = 1;
+    while (0 != (codePoint >> (4 * digits))) {
+        ++digits;
+    }
+
+    switch (unicodeInput) {
+    case UnicodeInput::linuxCtrlShiftU:
+        return 2 + 2 * digits + 2;	// Ctrl+Shift+U, digits, space
+    case UnicodeInput::windowsHexNumpad:
+        if (codePoint > 0xffff) {
+            break;
+        }
+        return 1 + 2 + 2 * digits + 1;	// Alt down, numpad +, digits, Alt up
+    case UnicodeInput::none:
+        break;
+    }
+    return unavailableCost;
+}
+
+size_t Keyboard_::typeUnicodeKey_(UnicodeKey const & unicodeKey)
+{
+    uint8_t key;
+    uint8_t modifiers;
+    if (0 != unicodeKey.deadKey) {
+        decodeLayoutKey(0, unicodeKey.deadKey, key, modifiers);
+        if (!typeKey_(key, modifiers)) {
+            return 0;
+        }
+        return typeAscii_(unicodeKey.key);	// the base character completes the dead key
+    }
+    decodeLayoutKey(0, unicodeKey.key, key, modifiers);
+    return typeKey_(key, modifiers);
+}
+
+size_t Keyboard_::typeUnicodeInput_(uint32_t codePoint)
+{
+    uint8_t key;
+    uint8_t modifiers;
+    switch (unicodeInput) {
+    case UnicodeInput::linuxCtrlShiftU:
+        decodeKey_('u', key, modifiers);
+        if (!typeKey_(key, 0x01 | 0x02)) {	// left ctrl and left shift
+            return 0;
+        }
+        if (!typeHexDigits_(codePoint, false)) {
+            return 0;
+        }
+        return typeAscii_(' ');
+    case UnicodeInput::windowsHexNumpad:
+        if (!press(KEY_LEFT_ALT)) {
+            return 0;
+        }
+        if (!typeKey_(0x57, 0) || !typeHexDigits_(codePoint, true)) {	// numpad +
+            release(KEY_LEFT_ALT);
+            return 0;
+        }
+        return release(KEY_LEFT_ALT);
+    case UnicodeInput::none:
+        break;
+    }
+    setWriteError();
+    return 0;
+}
+
+// typeAscii_() types the printing character c like write(), but as part
+// of another character.
+size_t Keyboard_::typeAscii_(uint8_t c)
+{
+    uint8_t key;
+    uint8_t modifiers;
+    if (!decodeKey_(c, key, modifiers)) {
+        setWriteError();
+        return 0;
+    }
+    return typeKey_(key, modifiers);
+}
+
+// typeHexDigits_() types codePoint in lower case hex without leading zeros,
+// the decimal digits on the numpad if numpad is set.
+size_t Keyboard_::typeHexDigits_(uint32_t codePoint, bool numpad)
+{
+    uint8_t shift = 28;
+    while ((shift > 0) && (0 == (codePoint >> shift))) {
+        shift -= 4;
+    }
+    for (;;) {
+        uint8_t const digit = (codePoint >> shift) & 0x0f;
+        size_t written;
+        if (digit >= 10) {
+            written = typeAscii_('a' + digit - 10);
+        } else if (numpad) {
+            written = typeKey_((0 == digit) ? 0x62 : (0x58 + digit), 0);	// numpad 0, 1 - 9
+        } else {
+            written = typeAscii_('0' + digit);
+        }
+        if (!written) {
+            return 0;
+        }
+        if (0 == shift) {
+            return 1;
+        }
+        shift -= 4;
+    }
+}
+
+// writeReports_P() sends count ready-made reports from PROGMEM as they are
+// [see CompiledMessage.h]. They are expected to start from and end in a
+// state with all keys released.
+size_t Keyboard_::writeReports_P(const KeyReport *reports, size_t count)
+{
+    releaseRolloverKey_();
+    for (size_t i = 0; i < count; ++i) {
+#if defined(SLOW_KEYBOARD_NKRO)
+        KeyReport report;
+        Hal::readFlash(&report, reports + i, sizeof(KeyReport));
+        _keyReport.modifiers = report.modifiers;
+        memset(_keyReport.keys, 0, sizeof(_keyReport.keys));
+        for (uint8_t j = 0; j < 6; j++) {
+            addKey_(report.keys[j]);
+        }
+#else
+        Hal::readFlash(&_keyReport, reports + i, sizeof(KeyReport));
+#endif
+        sendReport(&_keyReport);
+    }
+    return count;
+}
+
+// flush() releases the character still held down by rolloverTyping and
+// waits for all queued reports to be sent - or for the report releasing
+// all keys if cancelled.
+void Keyboard_::flush(void)
+{
+    releaseRolloverKey_();
+    if (cancelRequested_ && !cancelReleased_) {
+        Report released = {};
+        sendReport(&released);
+    }
+    waitForQueuedReports_();
+}
+
+void Keyboard_::cancel(void)
+{
+    cancelRequested_ = true;
+    Hal::InterruptLock lock;
+    if (Hal::reportTimerRunning()) {
+        Hal::startReportTimer();	// check now instead of after the timing of the queued report
+    }
+}
+
+bool Keyboard_::cancelled(void) const
+{
+    return cancelRequested_;
+}
+
+void Keyboard_::pause(unsigned long ms)
 {
-    unsigned long now = 0;
-    do
+    flush();
+    unsigned long const start = Hal::millis();
+    while (!cancelRequested_ && ((Hal::millis() - start) < ms)) {
+        whileWaiting_();
+        Hal::pollDelay(cancelPollIntervalUs);
+    }
+}
+
+// releaseRolloverKey_() releases the character still held down by rolloverTyping.
+void Keyboard_::releaseRolloverKey_()
+{
+    if (0 != rolloverKey_) {
+        _keyReport.modifiers &= ~rolloverModifiers_;
+        removeKey_(rolloverKey_);
+        rolloverKey_ = 0;
+        rolloverModifiers_ = 0;
+        sendReport(&_keyReport);
+    }
+}
+
+// timingDelayUs_() returns how long keys has to wait after lastReport_ by
+// timing [0 for the pacing alone] and remembers whether it releases a
+// special key. settle is set if keys presses new modifiers together with a
+// key, which should get a report of their own first.
+uint16_t Keyboard_::timingDelayUs_(Report const * keys, bool & settle)
+{
+    bool const modifiersPressed = (0 != (keys->modifiers & ~lastReport_.modifiers));
+    bool keysPressed = false;
+    bool released = (0 != (lastReport_.modifiers & ~keys->modifiers));
+    bool specialKeyReleased = false;
+#if defined(SLOW_KEYBOARD_NKRO)
+    for (uint8_t i = 0; i < sizeof(keys->keys); i++) {
+        uint8_t const up = lastReport_.keys[i] & ~keys->keys[i];
+        keysPressed = keysPressed || (0 != (keys->keys[i] & ~lastReport_.keys[i]));
+        released = released || (0 != up);
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            if ((0 != (up & (1 << bit))) && specialKey_(8 * i + bit)) {
+                specialKeyReleased = true;
+            }
+        }
+    }
+#else
+    for (uint8_t i = 0; i < 6; i++) {
+        bool wasDown = false;
+        bool isDown = false;
+        for (uint8_t j = 0; j < 6; j++) {
+            wasDown = wasDown || (keys->keys[i] == lastReport_.keys[j]);
+            isDown = isDown || (lastReport_.keys[i] == keys->keys[j]);
+        }
+        keysPressed = keysPressed || ((0 != keys->keys[i]) && !wasDown);
+        if ((0 != lastReport_.keys[i]) && !isDown) {
+            released = true;
+            specialKeyReleased = specialKeyReleased || specialKey_(lastReport_.keys[i]);
+        }
+    }
+#endif
+
+    uint16_t delayUs = 0;
+    if (modifiersPressed || keysPressed) {
+        delayUs = timing.gapUs;
+    }
+    if (released && (timing.holdUs > delayUs)) {
+        delayUs = timing.holdUs;
+    }
+    if (specialKeyReleased_ && (timing.specialKeyUs > delayUs)) {
+        delayUs = timing.specialKeyUs;
+    }
+    settle = modifiersPressed && keysPressed && (0 != timing.modifierSettleUs);
+    specialKeyReleased_ = specialKeyReleased;
+    return delayUs;
+}
+
+// specialKey_() returns true for Return, Escape, Backspace, Tab, the F-keys
+// and the navigation keys.
+bool Keyboard_::specialKey_(uint8_t usage)
+{
+    return ((0x28 <= usage) && (usage <= 0x2b)) || ((0x39 <= usage) && (usage <= 0x52)) ||
+           ((0x68 <= usage) && (usage <= 0x73));
+}
+
+// adaptRate_() sets minimumReportDelayUs from the host's round trip if a
+// measurement is due [see adaptiveRate].
+void Keyboard_::adaptRate_()
+{
+    unsigned long const now = Hal::millis();
+    bool const paused = (now - lastCharacterMs_) >= adaptiveRatePauseMs;
+    lastCharacterMs_ = now;
+    if (hostLedsMissing_ || (!paused && (0 != charactersUntilRoundTrip_--))) {
+        return;
+    }
+    charactersUntilRoundTrip_ = adaptiveRateInterval;
+
+    uint8_t key;
+    uint8_t modifiers;
+    if (!decodeKey_(adaptiveRateKey, key, modifiers)) {
+        return;
+    }
+    uint8_t const led = (0x53 == key) ? 0x01 : ((0x39 == key) ? 0x02 : ((0x47 == key) ? 0x04 : 0));
+    if (0 == led) {
+        return;
+    }
+
+    releaseRolloverKey_();
+    if (cancelRequested_) {
+        return;
+    }
+    // Both presses go out even if cancelled meanwhile, or the lock would stay toggled.
+    measuringRoundTrip_ = true;
+    unsigned long const first = measureRoundTrip_(key, led);
+    unsigned long const second = measureRoundTrip_(key, led);	// toggles the lock back
+    waitForQueuedReports_();
+    measuringRoundTrip_ = false;
+    if (cancelRequested_) {
+        return;		// the measurement was cut short
+    }
+    unsigned long roundTrip = (first > second) ? first : second;
+    if (roundTrip >= hostRoundTripTimeoutUs) {
+        if (0 == hostRoundTripUs_) {
+            hostLedsMissing_ = true;	// never seen the LED change, so keep minimumReportDelayUs
+            return;
+        }
+        roundTrip = adaptiveRateCeilingUs;	// an echo got lost - the host is busy
+    }
+    hostRoundTripUs_ = roundTrip;
+    minimumReportDelayUs = (roundTrip < adaptiveRateFloorUs) ? adaptiveRateFloorUs
+                           : ((roundTrip > adaptiveRateCeilingUs) ? adaptiveRateCeilingUs : roundTrip);
+    lastCharacterMs_ = Hal::millis();
+}
+
+// measureRoundTrip_() presses key, waits until the host toggles the LED
+// bit led and releases key again. Returns the time from sending the press
+// to the LED change, at least hostRoundTripTimeoutUs if there was none.
+unsigned long Keyboard_::measureRoundTrip_(uint8_t key, uint8_t led)
+{
+    uint8_t const leds = Hal::keyboardLeds();
+    addKey_(key);
+    sendReport(&_keyReport);
+    waitForQueuedReports_();
+    unsigned long const start = lastReportTimeUs_;	// when the press was sent
+
+    unsigned long elapsed = Hal::micros() - start;
+    while ((0 == ((Hal::keyboardLeds() ^ leds) & led)) && (elapsed < hostRoundTripTimeoutUs) && !cancelRequested_) {
+        whileWaiting_();
+        Hal::pollDelay(usbPollIntervalUs);
+        elapsed = Hal::micros() - start;
+    }
+
+    removeKey_(key);
+    sendReport(&_keyReport);
+    return elapsed;
+}
+
+unsigned long Keyboard_::hostRoundTripUs(void) const
+{
+    return hostRoundTripUs_;
+}
+
+// availableForWrite() returns how many characters fit into the report
+// queue, i.e. can be written without blocking when asynchronous.
+int Keyboard_::availableForWrite(void)
+{
+    uint8_t const used = (reportQueueTail_ - reportQueueHead_) & (reportQueueSize - 1);
+    return (reportQueueSize - 1 - used) / 2;
+}
+
+// idle() returns true once all queued reports have been sent.
+bool Keyboard_::idle(void) const
+{
+    return (reportQueueHead_ == reportQueueTail_);
+}
+
+// queueReport_() appends a copy of keys [sent delayUs after the previous one
+// at the earliest] to the report queue and makes sure the timer runs. If the
+// queue is full, it sleeps until there is room.
+void Keyboard_::queueReport_(Report const * keys, uint16_t delayUs)
+{
+    uint8_t const tail = reportQueueTail_;
+    uint8_t const next = (tail + 1) & (reportQueueSize - 1);
+#if defined(SLOW_KEYBOARD_STATISTICS)
+    unsigned long const start = Hal::micros();
+#endif
+    while (next == reportQueueHead_) {
+        whileWaiting_();
+        Hal::sleep();
+    }
+#if defined(SLOW_KEYBOARD_STATISTICS)
+    statistics.waitUs.record(Hal::micros() - start);
+#endif
+    if (cancelReleased_) {
+        return;
+    }
+    reportQueue_[tail] = *keys;
+    reportQueueDelayUs_[tail] = delayUs;
+
+    Hal::InterruptLock lock;	// also a memory barrier, so the report is complete before the interrupt can see it
+    reportQueueTail_ = next;
+    if (!Hal::reportTimerRunning()) {
+        Hal::startReportTimer();
+    }
+}
+
+// waitForQueuedReports_() sleeps until the report queue is empty.
+void Keyboard_::waitForQueuedReports_()
+{
+    while (!idle()) {
+        whileWaiting_();
+        Hal::sleep();
+    }
+}
+
+void Keyboard_::onReportTimer(void)
+{
+    uint8_t const head = reportQueueHead_;
+    if (head == reportQueueTail_) {
+        Hal::stopReportTimer();
+        return;
+    }
+
+    if (cancelReleased_) {
+        reportQueueHead_ = reportQueueTail_;	// queued while cancelling
+        Hal::stopReportTimer();
+        return;
+    }
+
+    unsigned long const now = Hal::micros();
+    uint16_t const delayUs = cancelRequested_ ? 0 : reportQueueDelayUs_[head];
+    // Only send if the endpoint has room - USB_Send() would delay() otherwise.
+    if (reportDue_(now, delayUs) && (!Hal::usbConfigured() || Hal::keyboardEndpointWritable(sizeof(Report)))) {
+        if (cancelRequested_ && !measuringRoundTrip_) {
+            // Release all keys instead and drop the rest of the queue.
+            memset(&reportQueue_[head], 0, sizeof(Report));
+            cancelReleased_ = true;
+        }
+        sendReportNow_(&reportQueue_[head]);
+        logReport_(now);
+#if defined(SLOW_KEYBOARD_TRACE)
+        trace.record(now, reportQueue_[head]);
+#endif
+        reportQueueHead_ = cancelReleased_ ? reportQueueTail_ : ((head + 1) & (reportQueueSize - 1));
+        if (reportQueueHead_ == reportQueueTail_) {
+            Hal::stopReportTimer();
+            return;
+        }
+    }
+
+    Hal::scheduleReportTimer(untilNextReportCheckUs_(Hal::micros(), cancelRequested_ ? 0 : reportQueueDelayUs_[reportQueueHead_]));
+}
+
+// whileWaiting_() calls whileWaiting if set.
+void Keyboard_::whileWaiting_()
+{
+    if (nullptr != whileWaiting) {
+        whileWaiting();
+    }
+}
+
+// waitTillNextReportTime_() busy waits until reportDue_() and returns that
+// time, without delayUs once cancelled.
+unsigned long Keyboard_::waitTillNextReportTime_(uint16_t delayUs)
+{
+    unsigned long now = Hal::micros();
+    while (!reportDue_(now, cancelRequested_ ? 0 : delayUs))
+    {
+        whileWaiting_();
+        unsigned long const untilCheckUs = untilNextReportCheckUs_(now, cancelRequested_ ? 0 : delayUs);
+        Hal::pollDelay(((nullptr != whileWaiting) && (untilCheckUs > cancelPollIntervalUs)) ? cancelPollIntervalUs : untilCheckUs);
+        now = Hal::micros();
+    }
+    return now;
+}
+
+// reportDue_() returns true once a report which has to wait delayUs [from
+// timing, 0 for none] after the previous one may be sent - and the
+// minimumReportDelayUs at least with fixed delay pacing.
+bool Keyboard_::reportDue_(unsigned long now, uint16_t delayUs) const
+{
+    unsigned long const elapsedUs = now - lastReportTimeUs_;
+    if ((ReportPacing::fixedDelay != reportPacing) && Hal::usbConfigured())
+    {
+        return (elapsedUs >= delayUs) && (usbReadyForReport_() || (elapsedUs >= usbPacingTimeoutUs));
+    }
+    return (elapsedUs >= ((minimumReportDelayUs < delayUs) ? delayUs : minimumReportDelayUs));
+}
+
+// untilNextReportCheckUs_() returns how long reportDue_() will stay false at least.
+unsigned long Keyboard_::untilNextReportCheckUs_(unsigned long now, uint16_t delayUs) const
+{
+    unsigned long const elapsedUs = now - lastReportTimeUs_;
+    if ((ReportPacing::fixedDelay != reportPacing) && Hal::usbConfigured())
     {
-        now = micros();
+        return (elapsedUs < delayUs) ? (delayUs - elapsedUs) : usbPollIntervalUs;
     }
-    while ((now - lastReportTimeUs_) < minimumReportDelayUs);
+    unsigned long const dueUs = (minimumReportDelayUs < delayUs) ? delayUs : minimumReportDelayUs;
+    return (elapsedUs < dueUs) ? (dueUs - elapsedUs) : 0;
+}
+
+void Keyboard_::logReport_(unsigned long now)
+{
+#if defined(SLOW_KEYBOARD_STATISTICS)
+    statistics.intervalUs.record(now - lastReportTimeUs_);
+    statistics.reports++;
+#endif
     lastReportTimeUs_ = now;
+    lastReportFrame_ = Hal::usbFrameNumber();
 }
 
+bool Keyboard_::usbReadyForReport_() const
+{
+    switch (reportPacing)
+    {
+    case ReportPacing::endpointDrained:
+        return Hal::keyboardEndpointDrained();
+    case ReportPacing::usbFrames:
+        return (((Hal::usbFrameNumber() - lastReportFrame_) & 0x07ff) >= framesPerReport);
+    case ReportPacing::fixedDelay:
+        break;
+    }
+    return true;
+}
 
 Keyboard_ Keyboard;
 
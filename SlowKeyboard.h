@@ -22,6 +22,25 @@
 #ifndef KEYBOARD_h
 #define KEYBOARD_h
 
+// Uncomment to send N-key rollover reports [one bit per key, see NkroReport]
+// instead of the 6-key array. Falls back to the latter under boot protocol.
+//#define SLOW_KEYBOARD_NKRO
+
+// Uncomment to keep KeyboardStatistics [report timing histograms and
+// totals] in Keyboard_::statistics. Costs nothing otherwise.
+//#define SLOW_KEYBOARD_STATISTICS
+
+// Uncomment to record the last reports sent in Keyboard_::trace [see
+// ReportTrace.h]. Takes traceSize * 10 bytes of RAM [18 with NKRO].
+//#define SLOW_KEYBOARD_TRACE
+
+// Uncomment to give the keyboard a USB interface of its own [a boot
+// keyboard with its own endpoint, see KeyboardInterface.h] which the host
+// polls every SLOW_KEYBOARD_USB_INTERFACE ms [1 - 255], instead of sharing
+// the HID() interface of the Arduino core. Use it with a lower
+// minimumReportDelayUs or ReportPacing::usbFrames.
+//#define SLOW_KEYBOARD_USB_INTERFACE 1
+
 #define _USING_HID
 
 #include "HID.h"
@@ -60,6 +79,8 @@
 #define KEY_HOME          0xD2
 #define KEY_END           0xD5
 #define KEY_CAPS_LOCK     0xC1
+#define KEY_SCROLL_LOCK   0xCF
+#define KEY_NUM_LOCK      0xDB
 #define KEY_F1            0xC2
 #define KEY_F2            0xC3
 #define KEY_F3            0xC4
@@ -86,11 +107,20 @@
 #define KEY_F24           0xFB
 
 // Supported keyboard layouts
-extern const uint8_t KeyboardLayout_de_DE[];
-extern const uint8_t KeyboardLayout_en_US[];
-extern const uint8_t KeyboardLayout_es_ES[];
-extern const uint8_t KeyboardLayout_fr_FR[];
-extern const uint8_t KeyboardLayout_it_IT[];
+#include "KeyboardLayout_de_DE.h"
+#include "KeyboardLayout_en_US.h"
+#include "KeyboardLayout_es_ES.h"
+#include "KeyboardLayout_fr_FR.h"
+#include "KeyboardLayout_it_IT.h"
+
+#include "TimingProfile.h"
+
+#if defined(SLOW_KEYBOARD_STATISTICS)
+#include "KeyboardStatistics.h"
+#endif
+#if defined(SLOW_KEYBOARD_TRACE)
+#include "ReportTrace.h"
+#endif
 
 // Low level key report: up to 6 keys and shift, ctrl etc at once
 typedef struct
@@ -100,12 +130,27 @@ typedef struct
     uint8_t keys[6];
 } KeyReport;
 
+#if defined(SLOW_KEYBOARD_NKRO)
+// N-key rollover report: shift, ctrl etc and one bit per key
+// [usage k is bit k % 8 of keys[k / 8], covering 0x00 to 0x77].
+typedef struct
+{
+    uint8_t modifiers;
+    uint8_t keys[15];
+} NkroReport;
+#endif
+
 class Keyboard_ : public Print
 {
 private:
-    KeyReport _keyReport;
+#if defined(SLOW_KEYBOARD_NKRO)
+    typedef NkroReport Report;
+#else
+    typedef KeyReport Report;
+#endif
+    Report _keyReport;
     const uint8_t *_asciimap;
-    void sendReport(KeyReport* keys);
+    void sendReport(Report* keys);
 
     Keyboard_(Keyboard_ const & other) = delete;
     Keyboard_ & operator=(Keyboard_ const & other) = delete;
@@ -115,20 +160,267 @@ private:
 public:
     Keyboard_(void);
     void begin(const uint8_t *layout = KeyboardLayout_en_US);
+    // Also types the characters of unicodeKeys [e.g. KeyboardLayout_de_DE_unicode].
+    void begin(const uint8_t *layout, const UnicodeKey *unicodeKeys, uint8_t unicodeKeyCount);
+    template <size_t N>
+    void begin(const uint8_t *layout, const UnicodeKey (&unicodeKeys)[N])
+    {
+        static_assert(N < 256, "too many unicode keys");
+        begin(layout, unicodeKeys, N);
+    }
     void end(void);
     size_t write(uint8_t k);
+    size_t writeUnicode(uint32_t codePoint);
     size_t write(const uint8_t *buffer, size_t size);
+    // Type text from PROGMEM [F("...") or up to size bytes of buffer]
+    // straight from flash, like write() does from RAM.
+    size_t write(const __FlashStringHelper *string);
+    size_t write_P(const uint8_t *buffer, size_t size);
+    void flush(void);
+    size_t writeReports_P(const KeyReport *reports, size_t count);
+    template <size_t N>
+    size_t writeReports_P(const KeyReport (&reports)[N])
+    {
+        return writeReports_P(reports, N);
+    }
+    // Types the characters of source [anything with an int read() returning
+    // -1 at its end, e.g. CompressedMessage::Reader] as they are produced.
+    template <typename Source>
+    size_t writeFrom(Source & source)
+    {
+        size_t n = 0;
+        int c;
+        while ((c = source.read()) >= 0) {
+            if (c != '\r') {
+                if (!write(static_cast<uint8_t>(c))) {
+                    break;
+                }
+                n++;
+            }
+        }
+        return n;
+    }
     size_t press(uint8_t k);
     size_t release(uint8_t k);
     void releaseAll(void);
+    int availableForWrite(void);
+    bool idle(void) const;
+
+    // Stops typing at the next report boundary: the report due next [at the
+    // usual pacing, without timing] is one releasing all keys, queued
+    // reports are dropped and everything typed afterwards is ignored
+    // [write() returns 0] until begin(). May be called from interrupts and
+    // from whileWaiting.
+    void cancel(void);
+    // Returns true from cancel() until begin().
+    bool cancelled(void) const;
+    // Called every cancelPollIntervalUs at most while waiting for the next
+    // report, for room in the queue or in pause() - e.g. to check a button
+    // or the serial port for cancel(). nullptr for none.
+    void (*whileWaiting)(void);
+    static unsigned long constexpr cancelPollIntervalUs = 1000ul;
+    // flush()es and waits ms, ending early when cancelled.
+    void pause(unsigned long ms);
 
+    // Called from the report timer interrupt - not meant to be called otherwise.
+    void onReportTimer(void);
+
+    static unsigned long constexpr defaultMinimumReportDelayUs = 16667ul;
     unsigned long minimumReportDelayUs;
 
+    // How the time for sending the next report is determined.
+    enum class ReportPacing : uint8_t
+    {
+        fixedDelay,      // minimumReportDelayUs after the previous report
+        endpointDrained, // as soon as the host has fetched the previous report from the HID IN endpoint
+        usbFrames        // framesPerReport USB frames [1ms each] after the previous report
+    };
+    // The USB based pacings fall back to fixedDelay while the device is not configured.
+    ReportPacing reportPacing;
+    uint8_t framesPerReport;
+
+    // Extra waits by what a report does [hold time, inter-key gap, modifier
+    // settle time and delay after special keys, see TimingProfile.h], e.g.
+    // TimingProfiles::get(index). All 0 by default.
+    TimingProfile timing;
+
+    // If set, write() presses the next key in the same report which releases the
+    // previous one [A down, A up + B down, B up, ...] - so text takes about one
+    // report per character instead of two. The last character is held until
+    // flush(), so call it before any delay() to prevent the host from autorepeating.
+    bool rolloverTyping;
+
+    // If set, reports are queued and sent from a timer interrupt, so press(),
+    // release() and write() return right away unless the queue is full. Use
+    // idle() to check for completion, availableForWrite() for the number of
+    // characters which can be written without blocking and flush() to wait
+    // [sleeping] until everything has been sent.
+    bool asynchronous;
+
+    // Capacity of the report queue for asynchronous, must be a power of 2.
+    static uint8_t constexpr reportQueueSize = 16;
+
+    // If set, write() decodes bytes from 0x80 on as UTF-8 instead of KEY_*
+    // codes [press() and release() still take those], so print("Grüße")
+    // works if the layout has a unicode table or unicodeInput is set.
+    bool utf8;
+
+    // How to enter characters the layout cannot type [neither directly
+    // nor as dead key plus base character] by their code point.
+    enum class UnicodeInput : uint8_t
+    {
+        none,
+        linuxCtrlShiftU, // IBus / GTK: Ctrl+Shift+U, hex digits, space
+        windowsHexNumpad // Alt held: numpad +, hex digits [needs EnableHexNumpad in the registry], up to 0xFFFF
+    };
+    UnicodeInput unicodeInput;
+
+    // If set, write() measures now and then how long the host takes to
+    // process a key press - by toggling adaptiveRateKey [KEY_CAPS_LOCK,
+    // KEY_NUM_LOCK or KEY_SCROLL_LOCK] twice and waiting for the host to
+    // set the LED [see Hal::keyboardLeds()] - and sets minimumReportDelayUs
+    // to that round trip, kept between adaptiveRateFloorUs and
+    // adaptiveRateCeilingUs. It measures at the first character after
+    // begin(), every adaptiveRateInterval characters and after typing paused
+    // for adaptiveRatePauseMs. If the host never sets the LED [e.g. with the
+    // shared HID() interface], minimumReportDelayUs is left alone and
+    // measuring stops for good.
+    bool adaptiveRate;
+    unsigned long adaptiveRateFloorUs;
+    unsigned long adaptiveRateCeilingUs;
+    uint8_t adaptiveRateKey;
+    static uint8_t constexpr adaptiveRateInterval = 64;
+    static unsigned long constexpr adaptiveRatePauseMs = 2000ul;
+    static unsigned long constexpr defaultAdaptiveRateFloorUs = 2000ul;
+    static unsigned long constexpr defaultAdaptiveRateCeilingUs = 50000ul;
+    // Returns the round trip measured last, 0 if there is none.
+    unsigned long hostRoundTripUs(void) const;
+
+#if defined(SLOW_KEYBOARD_STATISTICS)
+    // Updated from the report timer interrupt when asynchronous, so copy
+    // or reset it under a Hal::InterruptLock.
+    KeyboardStatistics statistics;
+#endif
+
+#if defined(SLOW_KEYBOARD_TRACE)
+    static uint8_t constexpr traceSize = 64;
+    // Recorded from the report timer interrupt when asynchronous, set
+    // trace.paused before reading it.
+    ReportTrace<Report, traceSize> trace;
+#endif
+
 protected:
 
-    void waitTillAndLogNextReportTime_();
+    // Reads text from PROGMEM for writeFrom() until '\0' or size bytes.
+    class FlashReader
+    {
+    public:
+        FlashReader(const uint8_t *next, size_t size);
+        int read();
+
+    private:
+        const uint8_t *next_;
+        size_t left_;
+    };
+
+    bool decodeKey_(uint8_t k, uint8_t & key, uint8_t & modifiers) const;
+    bool addKey_(uint8_t k);
+    void removeKey_(uint8_t k);
+    void releaseRolloverKey_();
+    size_t typeKey_(uint8_t key, uint8_t modifiers);
+    size_t typeAscii_(uint8_t c);
+
+    size_t writeUtf8Byte_(uint8_t c);
+    bool findUnicodeKey_(uint32_t codePoint, UnicodeKey & unicodeKey) const;
+    uint8_t unicodeInputCost_(uint32_t codePoint) const;
+    size_t typeUnicodeKey_(UnicodeKey const & unicodeKey);
+    size_t typeUnicodeInput_(uint32_t codePoint);
+    size_t typeHexDigits_(uint32_t codePoint, bool numpad);
+
+    // Number of reports for each way of entering a character [without
+    // rolloverTyping], writeUnicode() takes the cheapest one available.
+    static uint8_t constexpr directKeyCost = 2;
+    static uint8_t constexpr deadKeyCost = 4;
+    static uint8_t constexpr unavailableCost = 0xff;
+
+    // countCharacters_() adds n to the typed characters and returns it.
+#if defined(SLOW_KEYBOARD_STATISTICS)
+    size_t countCharacters_(size_t n)
+    {
+        statistics.characters += n;
+        return n;
+    }
+#else
+    static size_t countCharacters_(size_t n)
+    {
+        return n;
+    }
+#endif
+
+    uint16_t timingDelayUs_(Report const * keys, bool & settle);
+    static bool specialKey_(uint8_t usage);
+
+    void adaptRate_();
+    unsigned long measureRoundTrip_(uint8_t key, uint8_t led);
+
+    // A round trip taking this long counts as no LED change.
+    static unsigned long constexpr hostRoundTripTimeoutUs = 250000ul;
+
+    void whileWaiting_();
+    unsigned long waitTillNextReportTime_(uint16_t delayUs);
+    bool reportDue_(unsigned long now, uint16_t delayUs) const;
+    unsigned long untilNextReportCheckUs_(unsigned long now, uint16_t delayUs) const;
+    bool usbReadyForReport_() const;
+    void logReport_(unsigned long now);
+
+    void sendTimedReport_(Report const * keys, uint16_t delayUs);
+    void sendReportNow_(Report const * keys);
+    void queueReport_(Report const * keys, uint16_t delayUs);
+    void waitForQueuedReports_();
+
+    // Give up waiting for the host after this long [like USB_Send() does].
+    static unsigned long constexpr usbPacingTimeoutUs = 250000ul;
+    // How often to check the USB based pacings when asynchronous.
+    static unsigned long constexpr usbPollIntervalUs = 250ul;
 
     unsigned long lastReportTimeUs_;
+    uint16_t lastReportFrame_;
+
+    // The report sent or queued last, which timing compares the next one
+    // with, and whether it released a special key.
+    Report lastReport_;
+    bool specialKeyReleased_;
+
+    const UnicodeKey *unicodeKeys_;
+    uint8_t unicodeKeyCount_;
+
+    // Code point being decoded by write() and the number of bytes still missing.
+    uint32_t utf8CodePoint_;
+    uint8_t utf8Remaining_;
+
+    // Key and modifiers of the character still held down by rolloverTyping.
+    uint8_t rolloverKey_;
+    uint8_t rolloverModifiers_;
+
+    // State of adaptiveRate: characters until the next measurement, when
+    // the last one was written and whether the host never set the LED.
+    unsigned long hostRoundTripUs_;
+    unsigned long lastCharacterMs_;
+    uint8_t charactersUntilRoundTrip_;
+    bool hostLedsMissing_;
+
+    // Reports waiting to be sent when asynchronous. The interrupt advances
+    // the head after sending, queueReport_() the tail.
+    Report reportQueue_[reportQueueSize];
+    uint16_t reportQueueDelayUs_[reportQueueSize];	// from timing
+    uint8_t volatile reportQueueHead_;
+    uint8_t volatile reportQueueTail_;
+
+    // Set by cancel(), and once the report releasing all keys went out.
+    // Cancelling waits while adaptRate_() toggles the lock and back.
+    bool volatile cancelRequested_;
+    bool volatile cancelReleased_;
+    bool volatile measuringRoundTrip_;
 };
 extern Keyboard_ Keyboard;
 
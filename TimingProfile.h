@@ -0,0 +1,91 @@
+/*
+  TimingProfile.h
+
+  How long Keyboard_ waits before a report, by what the report does
+  compared to the previous one [see Keyboard_::timing]:
+
+    holdUs            it releases keys only
+    gapUs             it presses keys [or modifiers]
+    modifierSettleUs  it presses a key together with new modifiers - the
+                      modifiers then get a report of their own first and
+                      the key follows this much later
+    specialKeyUs      the previous report released a special key [Return,
+                      Escape, Backspace, Tab, F-keys, navigation keys]
+
+  A report doing several of these waits for the longest, and never less
+  than the minimumReportDelayUs [or the USB pacing] - so a profile only
+  lengthens the waits the settings, a macro's pace or the adaptive rate
+  ask for. 0 means nothing extra.
+
+    reportDelayUs     replaces minimumReportDelayUs where the profile is
+                      selected, so that it can go below the settings' delay
+                      as well - 0 keeps it
+
+  The named profiles are selected by index, by Settings::timingProfile for
+  all messages or by a macro for itself [see Macro.h].
+*/
+
+#ifndef TIMING_PROFILE_h
+#define TIMING_PROFILE_h
+
+#include "Hal.h"
+
+#include <Arduino.h>
+
+#include <stdint.h>
+#include <string.h>
+
+
+struct TimingProfile
+{
+    uint16_t holdUs;
+    uint16_t gapUs;
+    uint16_t modifierSettleUs;
+    uint16_t specialKeyUs;
+    uint16_t reportDelayUs;
+};
+
+namespace TimingProfiles
+{
+
+enum class Name : uint8_t
+{
+    standard,   // minimumReportDelayUs between any two reports
+    fast,       // the shortest gaps a bare-metal desktop takes reliably
+    careful,    // remote desktops, VMs and login dialogs
+    bios        // firmware setup screens and boot loaders
+};
+
+static uint8_t constexpr count = 4;
+static constexpr char const * names[count] = {"standard", "fast", "careful", "bios"};
+
+static constexpr TimingProfile table[count] PROGMEM = {{0, 0, 0, 0, 0},
+                                                       {4000, 2000, 0, 8000, 2000},
+                                                       {20000, 20000, 10000, 50000, 0},
+                                                       {30000, 30000, 30000, 65000, 0}};
+
+// Returns the profile index from flash, the standard one for an unknown index.
+inline TimingProfile get(uint8_t index)
+{
+    TimingProfile profile = {0, 0, 0, 0, 0};
+    if (count > index)
+    {
+        Hal::readFlash(&profile, &table[index], sizeof(profile));
+    }
+    return profile;
+}
+
+// Returns the index of the profile called name, count if there is none [for the host tools].
+inline uint8_t find(char const * name)
+{
+    uint8_t index = 0;
+    while ((count > index) && (0 != strcmp(names[index], name)))
+    {
+        ++index;
+    }
+    return index;
+}
+
+} // namespace TimingProfiles
+
+#endif
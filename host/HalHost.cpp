@@ -0,0 +1,687 @@
+/*
+  HalHost.cpp
+
+  Hal.h for the host build [see HalHost.h].
+*/
+
+#include "HalHost.h"
+#include "Hal.h"
+
+#include <string.h>
+
+#include <deque>
+#include <map>
+
+
+namespace
+{
+
+// Timer3 ticks with clk/64 at 16 MHz.
+unsigned long constexpr timerTickUs = 4;
+// Timer0 overflows about every millisecond and wakes the CPU from sleep.
+unsigned long constexpr timer0OverflowUs = 1024;
+// The ATmega32u4's endpoints are double banked.
+uint8_t constexpr endpointBanks = 2;
+// Erasing and writing an EEPROM cell takes 3.4ms.
+unsigned long constexpr eepromWriteUs = 3400;
+unsigned long constexpr defaultHostLedLatencyUs = 2000;
+// The host drives resume signalling for at least 20ms after a remote wakeup.
+unsigned long constexpr hostResumeUs = 20000;
+
+uint64_t now = 0;
+
+bool usbConfigured = true;
+bool bootProtocol = false;
+unsigned long hostPollIntervalUs = 1000;
+uint64_t nextHostPollUs = 0;
+uint8_t busyBanks = 0;
+std::vector<HalHost::Report> sentReports;
+
+struct LedChange
+{
+    uint64_t timeUs;
+    uint8_t toggled;
+};
+unsigned long hostLedLatencyUs = defaultHostLedLatencyUs;
+uint8_t lockKeysDown = 0;
+uint8_t leds = 0;
+std::deque<LedChange> ledChanges;
+
+bool timerRunning = false;
+uint64_t timerDeadlineUs = 0;
+uint64_t timerPeriodUs = timerTickUs;
+bool inInterrupt = false;
+
+bool usbSuspended = false;
+bool remoteWakeupEnabled = true;
+bool resuming = false;
+uint64_t resumeUs = 0;
+
+bool buttonDown = false;
+bool buttonInterruptEnabled = false;
+bool led = false;
+std::vector<HalHost::LedEdge> ledEdges;
+
+std::multimap<uint64_t, std::function<void()>> scriptedEvents;
+uint64_t stopUs = 0;
+uint64_t sleepingUs = 0;
+uint64_t poweredDownUs = 0;
+uint64_t * asleepTotal = nullptr;	// the one of the two counting right now
+uint64_t asleepSinceUs = 0;
+
+// Adds the time until its end [or until Stopped] to total.
+class Asleep
+{
+public:
+    explicit Asleep(uint64_t & total)
+    {
+        asleepTotal = &total;
+        asleepSinceUs = now;
+    }
+
+    ~Asleep()
+    {
+        *asleepTotal += now - asleepSinceUs;
+        asleepTotal = nullptr;
+    }
+};
+
+// Returns total including the time asleep so far.
+uint64_t asleepUs(uint64_t const & total)
+{
+    return total + ((&total == asleepTotal) ? (now - asleepSinceUs) : 0);
+}
+
+std::deque<uint8_t> serialReceived;
+std::vector<uint8_t> serialSent;
+
+uint8_t * eepromData()
+{
+    // Erased EEPROM cells read 0xff.
+    static uint8_t data[Hal::eepromSize];
+    static bool const erased = (memset(data, 0xff, sizeof(data)), true);
+    (void)erased;
+    return data;
+}
+
+void advanceTo(uint64_t targetUs)
+{
+    bool const stopping = (0 != stopUs) && (stopUs <= targetUs) && !inInterrupt;
+    if (stopping)
+    {
+        targetUs = stopUs;
+    }
+    while (true)
+    {
+        bool const timerDue = timerRunning && !inInterrupt && (timerDeadlineUs <= targetUs);
+        bool const eventDue = !inInterrupt && !scriptedEvents.empty() && (scriptedEvents.begin()->first <= targetUs);
+        if (eventDue && (!timerDue || (scriptedEvents.begin()->first < timerDeadlineUs)))
+        {
+            auto const next = scriptedEvents.begin();
+            if (now < next->first)
+            {
+                now = next->first;
+            }
+            std::function<void()> const event = next->second;
+            scriptedEvents.erase(next);
+            event();
+            continue;
+        }
+        if (!timerDue)
+        {
+            break;
+        }
+        if (now < timerDeadlineUs)
+        {
+            now = timerDeadlineUs;
+        }
+        uint64_t const deadlineUs = timerDeadlineUs;
+        inInterrupt = true;
+        Hal::reportTimerInterrupt();
+        inInterrupt = false;
+        if (timerRunning && (deadlineUs == timerDeadlineUs))
+        {
+            // Not rescheduled, so CTC mode fires again after the same period.
+            timerDeadlineUs += timerPeriodUs;
+        }
+    }
+    if (now < targetUs)
+    {
+        now = targetUs;
+    }
+    if (stopping)
+    {
+        throw HalHost::Stopped();
+    }
+}
+
+// Lets the host fetch every report it polled for until now.
+void updateEndpoint()
+{
+    if (nextHostPollUs > now)
+    {
+        return;
+    }
+    uint64_t const polls = (now - nextHostPollUs) / hostPollIntervalUs + 1;
+    busyBanks = (polls < busyBanks) ? static_cast<uint8_t>(busyBanks - polls) : 0;
+    nextHostPollUs += polls * hostPollIntervalUs;
+}
+
+std::vector<HalHost::Call> * recordedCalls = nullptr;
+
+void record(HalHost::Call::Function function, unsigned long argument)
+{
+    if (nullptr != recordedCalls)
+    {
+        recordedCalls->push_back({function, argument, {}});
+    }
+}
+
+// Returns the LED bits of the lock keys pressed in a keyboard report.
+uint8_t lockKeys(uint8_t id, uint8_t const * data, uint8_t size)
+{
+    uint8_t constexpr usages[] = {0x53, 0x39, 0x47};   // Num, Caps and Scroll Lock
+    uint8_t keys = 0;
+    for (uint8_t i = 0; i < sizeof(usages); ++i)
+    {
+        uint8_t const usage = usages[i];
+        bool down = false;
+        if (3 == id)
+        {
+            // N-key rollover bitmap after the modifiers
+            down = (1 + usage / 8 < size) && (0 != (data[1 + usage / 8] & (1 << (usage % 8))));
+        }
+        else
+        {
+            for (uint8_t k = 2; k < size; ++k)
+            {
+                down = down || (usage == data[k]);
+            }
+        }
+        if (down)
+        {
+            keys |= (1 << i);
+        }
+    }
+    return keys;
+}
+
+} // namespace
+
+
+namespace Hal
+{
+
+unsigned long micros()
+{
+    // unsigned long has 64 bits here, so it does not wrap like on the AVR.
+    return now;
+}
+
+unsigned long millis()
+{
+    return now / 1000;
+}
+
+void delay(unsigned long ms)
+{
+    record(HalHost::Call::Function::delay, ms);
+    advanceTo(now + ms * 1000ull);
+}
+
+void pollDelay(unsigned long maxUs)
+{
+    record(HalHost::Call::Function::pollDelay, maxUs);
+    advanceTo(now + ((0 < maxUs) ? maxUs : 1));
+}
+
+void sleep()
+{
+    record(HalHost::Call::Function::sleep, 0);
+    Asleep const asleep(sleepingUs);
+    if (timerRunning && !inInterrupt && (timerDeadlineUs < now + timer0OverflowUs))
+    {
+        advanceTo(timerDeadlineUs);
+    }
+    else
+    {
+        advanceTo(now + timer0OverflowUs);
+    }
+}
+
+void powerDown()
+{
+    if (!usbSuspended())
+    {
+        sleep();    // the USB controller needs its clock, so timer0 still wakes the AVR
+        return;
+    }
+
+    // Nothing but the button and USB can wake the AVR then - so sleep until
+    // the next scripted event or the end of resume signalling, or like
+    // sleep() if there is neither.
+    Asleep const asleep(poweredDownUs);
+    uint64_t wakeUs = resuming ? resumeUs : 0;
+    if (!scriptedEvents.empty() && ((0 == wakeUs) || (scriptedEvents.begin()->first < wakeUs)))
+    {
+        wakeUs = scriptedEvents.begin()->first;
+    }
+    if ((0 == wakeUs) && (0 != stopUs))
+    {
+        wakeUs = stopUs;
+    }
+    advanceTo((0 != wakeUs) ? ((now < wakeUs) ? wakeUs : now) : (now + timer0OverflowUs));
+}
+
+InterruptLock::InterruptLock()
+    : sreg_(0)
+{
+}
+
+InterruptLock::~InterruptLock()
+{
+}
+
+uint8_t readFlashByte(uint8_t const * address)
+{
+    return *address;
+}
+
+void readFlash(void * destination, void const * source, size_t size)
+{
+    memcpy(destination, source, size);
+}
+
+uint8_t readEeprom(size_t address)
+{
+    return eepromData()[address % eepromSize];
+}
+
+void updateEeprom(size_t address, uint8_t value)
+{
+    uint8_t & cell = eepromData()[address % eepromSize];
+    if (cell != value)
+    {
+        cell = value;
+        advanceTo(now + eepromWriteUs);
+    }
+}
+
+void beginSerial()
+{
+}
+
+int readSerial()
+{
+    if (serialReceived.empty())
+    {
+        return -1;
+    }
+    uint8_t const value = serialReceived.front();
+    serialReceived.pop_front();
+    return value;
+}
+
+void writeSerial(void const * data, size_t size)
+{
+    uint8_t const * const bytes = static_cast<uint8_t const *>(data);
+    serialSent.insert(serialSent.end(), bytes, bytes + size);
+}
+
+void initPins()
+{
+}
+
+bool buttonDown()
+{
+    return ::buttonDown;
+}
+
+void setLed(bool on)
+{
+    if (led != on)
+    {
+        ledEdges.push_back({now, on});
+    }
+    led = on;
+}
+
+void enableButtonInterrupt()
+{
+    buttonInterruptEnabled = true;
+}
+
+void appendKeyboardDescriptor(uint8_t const * /*descriptor*/, uint16_t /*size*/)
+{
+}
+
+void sendKeyboardReport(uint8_t id, void const * data, uint8_t size)
+{
+    if (nullptr != recordedCalls)
+    {
+        HalHost::Call call = {HalHost::Call::Function::sendKeyboardReport, size, {}};
+        call.report.id = id;
+        call.report.size = (size < sizeof(call.report.data)) ? size : sizeof(call.report.data);
+        memcpy(call.report.data, data, call.report.size);
+        recordedCalls->push_back(call);
+    }
+    if (!::usbConfigured)
+    {
+        return; // USB_Send() fails right away
+    }
+    updateEndpoint();
+    while (endpointBanks <= busyBanks)
+    {
+        // USB_Send() waits for the host to fetch a bank.
+        advanceTo(nextHostPollUs);
+        updateEndpoint();
+    }
+    ++busyBanks;
+
+    uint8_t const keys = lockKeys(id, static_cast<uint8_t const *>(data), size);
+    uint8_t const pressed = keys & ~lockKeysDown;
+    lockKeysDown = keys;
+    if ((0 != pressed) && (~0ul != hostLedLatencyUs))
+    {
+        // Fetched with the last poll emptying the banks.
+        uint64_t const fetchedUs = nextHostPollUs + (busyBanks - 1) * static_cast<uint64_t>(hostPollIntervalUs);
+        ledChanges.push_back({fetchedUs + hostLedLatencyUs, pressed});
+    }
+
+    HalHost::Report report = {};
+    report.timeUs = now;
+    report.id = id;
+    report.size = (size < sizeof(report.data)) ? size : sizeof(report.data);
+    memcpy(report.data, data, report.size);
+    sentReports.push_back(report);
+}
+
+bool usbConfigured()
+{
+    return ::usbConfigured;
+}
+
+bool usbSuspended()
+{
+    if (resuming && (resumeUs <= now))
+    {
+        resuming = false;
+        ::usbSuspended = false;
+    }
+    return ::usbSuspended;
+}
+
+bool wakeupHost()
+{
+    if (!usbSuspended() || !remoteWakeupEnabled || resuming)
+    {
+        return false;
+    }
+    resuming = true;
+    resumeUs = now + hostResumeUs;
+    return true;
+}
+
+bool keyboardBootProtocol()
+{
+    return bootProtocol;
+}
+
+uint8_t keyboardLeds()
+{
+    record(HalHost::Call::Function::keyboardLeds, 0);
+    while (!ledChanges.empty() && (ledChanges.front().timeUs <= now))
+    {
+        leds ^= ledChanges.front().toggled;
+        ledChanges.pop_front();
+    }
+    return leds;
+}
+
+uint16_t usbFrameNumber()
+{
+    return (now / 1000) & 0x07ff;
+}
+
+bool keyboardEndpointDrained()
+{
+    record(HalHost::Call::Function::keyboardEndpointDrained, 0);
+    updateEndpoint();
+    return (0 == busyBanks);
+}
+
+bool keyboardEndpointWritable(uint8_t size)
+{
+    record(HalHost::Call::Function::keyboardEndpointWritable, size);
+    updateEndpoint();
+    return (busyBanks < endpointBanks);
+}
+
+void scheduleReportTimer(unsigned long delayUs)
+{
+    unsigned long ticks = delayUs / timerTickUs;
+    if (ticks < 1)
+    {
+        ticks = 1;
+    }
+    else if (ticks > 0xffff)
+    {
+        ticks = 0xffff;
+    }
+    timerPeriodUs = ticks * timerTickUs;
+    timerDeadlineUs = now + timerPeriodUs;
+}
+
+void startReportTimer()
+{
+    timerRunning = true;
+    scheduleReportTimer(0);
+}
+
+void stopReportTimer()
+{
+    timerRunning = false;
+}
+
+bool reportTimerRunning()
+{
+    return timerRunning;
+}
+
+} // namespace Hal
+
+
+namespace HalHost
+{
+
+void reset()
+{
+    usbConfigured = true;
+    bootProtocol = false;
+    usbSuspended = false;
+    remoteWakeupEnabled = true;
+    resuming = false;
+    hostPollIntervalUs = 1000;
+    nextHostPollUs = now;
+    busyBanks = 0;
+    sentReports.clear();
+    hostLedLatencyUs = defaultHostLedLatencyUs;
+    lockKeysDown = 0;
+    leds = 0;
+    ledChanges.clear();
+    timerRunning = false;
+    buttonDown = false;
+    buttonInterruptEnabled = false;
+    led = false;
+    ::ledEdges.clear();
+    scriptedEvents.clear();
+    stopUs = 0;
+    ::sleepingUs = 0;
+    ::poweredDownUs = 0;
+    serialReceived.clear();
+    serialSent.clear();
+    memset(eepromData(), 0xff, Hal::eepromSize);
+}
+
+uint64_t nowUs()
+{
+    return now;
+}
+
+void advanceUs(uint64_t us)
+{
+    advanceTo(now + us);
+}
+
+std::vector<Report> const & reports()
+{
+    return sentReports;
+}
+
+void clearReports()
+{
+    sentReports.clear();
+}
+
+void recordCalls(std::vector<Call> * calls)
+{
+    recordedCalls = calls;
+}
+
+void replay(std::vector<Call> const & calls)
+{
+    for (Call const & call : calls)
+    {
+        switch (call.function)
+        {
+        case Call::Function::delay:
+            Hal::delay(call.argument);
+            break;
+        case Call::Function::pollDelay:
+            Hal::pollDelay(call.argument);
+            break;
+        case Call::Function::sleep:
+            Hal::sleep();
+            break;
+        case Call::Function::sendKeyboardReport:
+            Hal::sendKeyboardReport(call.report.id, call.report.data, call.report.size);
+            break;
+        case Call::Function::keyboardEndpointDrained:
+            Hal::keyboardEndpointDrained();
+            break;
+        case Call::Function::keyboardEndpointWritable:
+            Hal::keyboardEndpointWritable(static_cast<uint8_t>(call.argument));
+            break;
+        case Call::Function::keyboardLeds:
+            Hal::keyboardLeds();
+            break;
+        }
+    }
+}
+
+void at(uint64_t timeUs, std::function<void()> event)
+{
+    scriptedEvents.emplace(timeUs, std::move(event));
+}
+
+void stopAt(uint64_t timeUs)
+{
+    stopUs = timeUs;
+}
+
+uint64_t sleepingUs()
+{
+    return asleepUs(::sleepingUs);
+}
+
+uint64_t poweredDownUs()
+{
+    return asleepUs(::poweredDownUs);
+}
+
+void setUsbConfigured(bool configured)
+{
+    usbConfigured = configured;
+    if (!configured)
+    {
+        busyBanks = 0;	// a bus reset clears the endpoints
+    }
+}
+
+void setBootProtocol(bool boot)
+{
+    bootProtocol = boot;
+}
+
+void setHostPollIntervalUs(unsigned long intervalUs)
+{
+    updateEndpoint();
+    hostPollIntervalUs = (0 < intervalUs) ? intervalUs : 1;
+}
+
+void startHostPolling(uint64_t timeUs)
+{
+    updateEndpoint();
+    nextHostPollUs = timeUs;
+}
+
+void setUsbSuspended(bool suspended)
+{
+    usbSuspended = suspended;
+    resuming = false;
+}
+
+void setRemoteWakeupEnabled(bool enabled)
+{
+    remoteWakeupEnabled = enabled;
+}
+
+void setHostLedLatencyUs(unsigned long latencyUs)
+{
+    hostLedLatencyUs = latencyUs;
+}
+
+void setButtonDown(bool down)
+{
+    bool const edge = (buttonDown != down);
+    buttonDown = down;
+    if (edge && buttonInterruptEnabled && !inInterrupt)
+    {
+        inInterrupt = true;
+        Hal::buttonInterrupt();
+        inInterrupt = false;
+    }
+}
+
+bool ledOn()
+{
+    return led;
+}
+
+std::vector<LedEdge> const & ledEdges()
+{
+    return ::ledEdges;
+}
+
+uint8_t * eeprom()
+{
+    return eepromData();
+}
+
+void receiveSerial(void const * data, size_t size)
+{
+    uint8_t const * const bytes = static_cast<uint8_t const *>(data);
+    serialReceived.insert(serialReceived.end(), bytes, bytes + size);
+}
+
+std::vector<uint8_t> const & serialOutput()
+{
+    return serialSent;
+}
+
+void clearSerialOutput()
+{
+    serialSent.clear();
+}
+
+} // namespace HalHost
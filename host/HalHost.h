@@ -0,0 +1,130 @@
+/*
+  HalHost.h
+
+  Control and inspection of the host implementation of Hal.h.
+
+  Time is virtual: it only advances when the code under test waits
+  [Hal::pollDelay(), Hal::sleep(), Hal::delay()] or when advanceUs() is
+  called, so simulating minutes of typing takes next to no real time. Timer
+  interrupts fire while time advances.
+
+  The USB host is modelled as polling the keyboard's IN endpoint [two banks,
+  like the ATmega32u4's] every hostPollIntervalUs. Each report handed to
+  Hal::sendKeyboardReport() is recorded with its virtual time stamp. Like
+  an operating system, the host toggles its lock LEDs when it fetches a
+  report pressing Caps, Num or Scroll Lock, and sets them hostLedLatencyUs
+  later [see Hal::keyboardLeds()].
+
+  Inputs can be scripted with at() to run code which never returns [like
+  setup() of main.cpp]: while USB is suspended Hal::powerDown() sleeps
+  until the next scripted event [otherwise like Hal::sleep()], and once
+  the time reaches stopAt() the waiting Hal functions throw Stopped.
+*/
+
+#ifndef HAL_HOST_h
+#define HAL_HOST_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+
+namespace HalHost
+{
+
+struct Report
+{
+    uint64_t timeUs;
+    uint8_t id;
+    uint8_t size;
+    uint8_t data[16];
+};
+
+// Restores the power-on state of USB, pins, EEPROM, serial, timer, the
+// scripted events and the recorded reports. The clock keeps running.
+void reset();
+
+uint64_t nowUs();
+void advanceUs(uint64_t us);
+
+std::vector<Report> const & reports();
+void clearReports();
+
+// A call of a Hal function which simulates the clock or the USB host.
+struct Call
+{
+    enum class Function : uint8_t
+    {
+        delay,
+        pollDelay,
+        sleep,
+        sendKeyboardReport,
+        keyboardEndpointDrained,
+        keyboardEndpointWritable,
+        keyboardLeds
+    };
+
+    Function function;
+    unsigned long argument;	// ms, us or size
+    Report report;	// sendKeyboardReport() only
+};
+
+// Appends every such call to calls from now on [nullptr to stop], so
+// replay() can repeat the simulation without the code which made them -
+// e.g. to tell its own time from the simulation's. Only for code without
+// interrupts [not Keyboard_::asynchronous].
+void recordCalls(std::vector<Call> * calls);
+void replay(std::vector<Call> const & calls);
+
+// Runs event [e.g. setButtonDown(true)] once the time reaches timeUs, in
+// the order of their times.
+void at(uint64_t timeUs, std::function<void()> event);
+
+// Thrown once the time reaches stopUs [0 for never].
+struct Stopped
+{
+};
+void stopAt(uint64_t stopUs);
+
+// Time spent in Hal::sleep() and in Hal::powerDown(), the rest is awake.
+uint64_t sleepingUs();
+uint64_t poweredDownUs();
+
+void setUsbConfigured(bool configured);
+void setBootProtocol(bool boot);
+void setHostPollIntervalUs(unsigned long intervalUs);
+// The host polls the keyboard endpoint first at timeUs, e.g. once its HID
+// driver is bound after configuring the device.
+void startHostPolling(uint64_t timeUs);
+void setUsbSuspended(bool suspended);
+// Whether Hal::wakeupHost() resumes the bus [after hostResumeUs].
+void setRemoteWakeupEnabled(bool enabled);
+// ~0ul for a host never setting the LEDs [like with the shared HID() interface].
+void setHostLedLatencyUs(unsigned long latencyUs);
+
+// Fires the pin change interrupt on each change once enabled.
+void setButtonDown(bool down);
+bool ledOn();
+
+struct LedEdge
+{
+    uint64_t timeUs;
+    bool on;
+};
+// Every change of Hal::setLed().
+std::vector<LedEdge> const & ledEdges();
+
+// Writing cells with Hal::updateEeprom() takes time like on the AVR.
+uint8_t * eeprom();
+
+// Queues bytes for Hal::readSerial().
+void receiveSerial(void const * data, size_t size);
+// Everything written by Hal::writeSerial().
+std::vector<uint8_t> const & serialOutput();
+void clearSerialOutput();
+
+} // namespace HalHost
+
+#endif
@@ -0,0 +1,225 @@
+/*
+  HostKeyboard.cpp
+
+  See HostKeyboard.h.
+*/
+
+#include "HostKeyboard.h"
+
+#include <algorithm>
+
+
+namespace
+{
+
+uint8_t constexpr ctrl = 0x01 | 0x10;
+uint8_t constexpr shift = 0x02 | 0x20;
+uint8_t constexpr leftAlt = 0x04;
+uint8_t constexpr numpadPlus = 0x57;
+uint8_t constexpr numpad1 = 0x59;
+uint8_t constexpr numpad0 = 0x62;
+
+// Returns true if the report has ErrorRollOver, POSTFail or ErrorUndefined.
+bool errorReport(uint8_t const * data, size_t size)
+{
+    if (16 == size)
+    {
+        return (0 != (data[1] & 0x0e));
+    }
+    for (size_t i = 2; i < size; ++i)
+    {
+        if ((1 <= data[i]) && (data[i] <= 3))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool hexDigit(uint32_t codePoint, uint8_t & digit)
+{
+    if (('0' <= codePoint) && (codePoint <= '9'))
+    {
+        digit = codePoint - '0';
+        return true;
+    }
+    if (('a' <= codePoint) && (codePoint <= 'f'))
+    {
+        digit = codePoint - 'a' + 10;
+        return true;
+    }
+    return false;
+}
+
+} // namespace
+
+HostKeyboard::HostKeyboard(Layouts::NamedLayout const & layout, Options const & options)
+    : decoder_(layout)
+    , options_(options)
+    , ignoredReports_(0)
+    , modifiers_(0)
+    , keysDown_(false)
+    , repeatUsage_(0)
+    , nextRepeatUs_(0)
+    , unicodeInputActive_(false)
+    , unicodeCodePoint_(0)
+    , unicodeDigits_(0)
+{
+    // intentionally empty
+}
+
+void HostKeyboard::report(uint64_t timeUs, uint8_t const * data, size_t size)
+{
+    repeatUntil_(timeUs);
+    if ((0 == size) || errorReport(data, size))
+    {
+        ++ignoredReports_;
+        return;
+    }
+
+    uint8_t const modifiers = data[0];
+    KeyDecoder::Event const event = decoder_.report(data, size);
+    if (event.released.end() != std::find(event.released.begin(), event.released.end(), repeatUsage_))
+    {
+        repeatUsage_ = 0;
+    }
+    type_(timeUs, event, modifiers);
+    if (!event.pressed.empty())
+    {
+        repeatUsage_ = event.pressed.back();
+        nextRepeatUs_ = timeUs + options_.repeatDelayUs;
+    }
+    modifiers_ = modifiers;
+    keysDown_ = std::any_of(data, data + size, [](uint8_t value)
+    {
+        return (0 != value);
+    });
+}
+
+bool HostKeyboard::finish(uint64_t timeUs)
+{
+    repeatUntil_(timeUs);
+    return !keysDown_;
+}
+
+std::vector<HostKeyboard::Character> const & HostKeyboard::characters() const
+{
+    return characters_;
+}
+
+size_t HostKeyboard::ignoredReports() const
+{
+    return ignoredReports_;
+}
+
+void HostKeyboard::repeatUntil_(uint64_t timeUs)
+{
+    while ((0 != repeatUsage_) && (nextRepeatUs_ < timeUs))
+    {
+        add_(nextRepeatUs_, decoder_.type(repeatUsage_, modifiers_), true);
+        nextRepeatUs_ += options_.repeatIntervalUs;
+    }
+}
+
+// type_() adds the text of event, entering it as code point while unicode input is active.
+void HostKeyboard::type_(uint64_t timeUs, KeyDecoder::Event const & event, uint8_t modifiers)
+{
+    switch (options_.unicodeInput)
+    {
+    case Keyboard_::UnicodeInput::linuxCtrlShiftU:
+        if ((0 != (modifiers & ctrl)) && (0 != (modifiers & shift)))
+        {
+            for (uint8_t const usage : event.pressed)
+            {
+                uint32_t codePoint;
+                if (decoder_.character(usage, 0, codePoint) && ('u' == codePoint))
+                {
+                    unicodeInputActive_ = true;
+                    unicodeCodePoint_ = 0;
+                    unicodeDigits_ = 0;
+                }
+            }
+            return;
+        }
+        if (unicodeInputActive_)
+        {
+            // Hex digits until space or Return commit the code point.
+            for (uint32_t const codePoint : KeyDecoder::decodeUtf8(event.text))
+            {
+                uint8_t digit;
+                if (unicodeInputActive_ && hexDigit(codePoint, digit))
+                {
+                    unicodeCodePoint_ = (unicodeCodePoint_ << 4) | digit;
+                    ++unicodeDigits_;
+                    continue;
+                }
+                bool const committing = unicodeInputActive_ && ((' ' == codePoint) || ('\n' == codePoint));
+                endUnicodeInput_(timeUs);
+                if (!committing)
+                {
+                    std::string text;
+                    KeyDecoder::appendUtf8(text, codePoint);
+                    add_(timeUs, text, false);
+                }
+            }
+            return;
+        }
+        break;
+    case Keyboard_::UnicodeInput::windowsHexNumpad:
+        if (0 != (modifiers & leftAlt))
+        {
+            for (uint8_t const usage : event.pressed)
+            {
+                uint32_t codePoint;
+                uint8_t digit;
+                if (numpadPlus == usage)
+                {
+                    unicodeInputActive_ = true;
+                    unicodeCodePoint_ = 0;
+                    unicodeDigits_ = 0;
+                }
+                else if (unicodeInputActive_ && (numpad1 <= usage) && (usage < numpad0))
+                {
+                    unicodeCodePoint_ = (unicodeCodePoint_ << 4) | (usage - numpad1 + 1);
+                    ++unicodeDigits_;
+                }
+                else if (unicodeInputActive_ && (numpad0 == usage))
+                {
+                    unicodeCodePoint_ <<= 4;
+                    ++unicodeDigits_;
+                }
+                else if (unicodeInputActive_ && decoder_.character(usage, 0, codePoint) && hexDigit(codePoint, digit))
+                {
+                    unicodeCodePoint_ = (unicodeCodePoint_ << 4) | digit;
+                    ++unicodeDigits_;
+                }
+            }
+            return;
+        }
+        if (0 != (modifiers_ & leftAlt))
+        {
+            endUnicodeInput_(timeUs);   // releasing Alt enters the code point
+        }
+        break;
+    case Keyboard_::UnicodeInput::none:
+        break;
+    }
+    add_(timeUs, event.text, false);
+}
+
+void HostKeyboard::add_(uint64_t timeUs, std::string const & text, bool repeated)
+{
+    for (uint32_t const codePoint : KeyDecoder::decodeUtf8(text))
+    {
+        characters_.push_back({timeUs, codePoint, repeated});
+    }
+}
+
+void HostKeyboard::endUnicodeInput_(uint64_t timeUs)
+{
+    if (unicodeInputActive_ && (0 != unicodeDigits_))
+    {
+        characters_.push_back({timeUs, unicodeCodePoint_, false});
+    }
+    unicodeInputActive_ = false;
+}
@@ -0,0 +1,79 @@
+/*
+  HostKeyboard.h
+
+  Model of what a host's keyboard driver makes of a stream of time stamped
+  reports: in each report it applies the modifiers first, then releases
+  the keys gone and presses the new ones in slot order [see KeyDecoder.h].
+  Reports with ErrorRollOver [or another error usage] are ignored, as the
+  key state is unknown. The last key pressed autorepeats after
+  repeatDelayUs every repeatIntervalUs while it is held, like typematic
+  repeat in Linux and Windows. Unicode input [see Keyboard_::unicodeInput]
+  is turned into the character entered.
+*/
+
+#ifndef HOST_KEYBOARD_h
+#define HOST_KEYBOARD_h
+
+#include "KeyDecoder.h"
+#include "Layouts.h"
+#include "SlowKeyboard.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+
+class HostKeyboard
+{
+public:
+    struct Options
+    {
+        // The shortest common settings, so anything close is caught.
+        unsigned long repeatDelayUs = 250000;
+        unsigned long repeatIntervalUs = 33333;
+        Keyboard_::UnicodeInput unicodeInput = Keyboard_::UnicodeInput::none;
+    };
+
+    struct Character
+    {
+        uint64_t timeUs;
+        uint32_t codePoint;
+        bool repeated;  // by autorepeat
+    };
+
+    HostKeyboard(Layouts::NamedLayout const & layout, Options const & options);
+
+    // Feeds the next report [see KeyDecoder::report()], timeUs must not decrease.
+    void report(uint64_t timeUs, uint8_t const * data, size_t size);
+
+    // Autorepeats up to timeUs. Returns false if a key is still held then.
+    bool finish(uint64_t timeUs);
+
+    std::vector<Character> const & characters() const;
+    size_t ignoredReports() const;
+
+private:
+    void repeatUntil_(uint64_t timeUs);
+    void type_(uint64_t timeUs, KeyDecoder::Event const & event, uint8_t modifiers);
+    void add_(uint64_t timeUs, std::string const & text, bool repeated);
+    void endUnicodeInput_(uint64_t timeUs);
+
+    KeyDecoder decoder_;
+    Options const options_;
+
+    std::vector<Character> characters_;
+    size_t ignoredReports_;
+
+    uint8_t modifiers_;
+    bool keysDown_;
+    uint8_t repeatUsage_;       // 0 if none
+    uint64_t nextRepeatUs_;
+
+    bool unicodeInputActive_;
+    uint32_t unicodeCodePoint_;
+    uint8_t unicodeDigits_;
+};
+
+#endif
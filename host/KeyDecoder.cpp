@@ -0,0 +1,270 @@
+/*
+  KeyDecoder.cpp
+
+  See KeyDecoder.h.
+*/
+
+#include "KeyDecoder.h"
+
+#include "KeyboardLayout.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+
+namespace
+{
+
+uint8_t constexpr textModifiers = 0x22 | 0x40;  // Shift, AltGr
+
+struct KeyName
+{
+    uint8_t usage;
+    char const * name;
+};
+
+KeyName constexpr keyNames[] = {{0x01, "ErrorRollOver"}, {0x28, "Return"}, {0x29, "Escape"}, {0x2a, "Backspace"},
+                                {0x2b, "Tab"}, {0x2c, "Space"}, {0x39, "CapsLock"}, {0x49, "Insert"},
+                                {0x4a, "Home"}, {0x4b, "PageUp"}, {0x4c, "Delete"}, {0x4d, "End"},
+                                {0x4e, "PageDown"}, {0x4f, "Right"}, {0x50, "Left"}, {0x51, "Down"},
+                                {0x52, "Up"}};
+
+} // namespace
+
+KeyDecoder::KeyDecoder(Layouts::NamedLayout const & layout)
+    : pendingDeadKey_(0)
+    , deadKeyPending_(false)
+{
+    // Printing characters first, so they win over control characters on the same key.
+    for (uint8_t c = ' '; c < 0x7f; ++c)
+    {
+        add_(c, layout.table[c], c);
+    }
+    for (uint8_t c = 0; c < ' '; ++c)
+    {
+        add_(c, layout.table[c], c);
+    }
+    for (uint8_t i = 0; i < layout.unicodeKeyCount; ++i)
+    {
+        UnicodeKey const & unicodeKey = layout.unicodeKeys[i];
+        if (0 == unicodeKey.deadKey)
+        {
+            add_('a', unicodeKey.key, unicodeKey.codePoint);
+            continue;
+        }
+        uint8_t key;
+        uint8_t modifiers;
+        decodeLayoutKey('a', unicodeKey.deadKey, key, modifiers);
+        deadKeys_[stroke_(key, modifiers)][unicodeKey.key] = unicodeKey.codePoint;
+    }
+}
+
+KeyDecoder::Event KeyDecoder::report(uint8_t modifiers, uint8_t const * keys, size_t count)
+{
+    std::vector<uint8_t> down;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if ((0 != keys[i]) && (down.end() == std::find(down.begin(), down.end(), keys[i])))
+        {
+            down.push_back(keys[i]);
+        }
+    }
+
+    Event event;
+    for (uint8_t const usage : down_)
+    {
+        if (down.end() == std::find(down.begin(), down.end(), usage))
+        {
+            event.released.push_back(usage);
+        }
+    }
+    for (uint8_t const usage : down)
+    {
+        if (down_.end() == std::find(down_.begin(), down_.end(), usage))
+        {
+            event.pressed.push_back(usage);
+            event.text += type(usage, modifiers);
+        }
+    }
+    down_ = down;
+    return event;
+}
+
+KeyDecoder::Event KeyDecoder::report(uint8_t const * data, size_t size)
+{
+    if (16 == size)
+    {
+        std::vector<uint8_t> keys;
+        for (unsigned k = 1; k < 8 * 15; ++k)
+        {
+            if (data[1 + (k >> 3)] & (1 << (k & 7)))
+            {
+                keys.push_back(static_cast<uint8_t>(k));
+            }
+        }
+        return report(data[0], keys.data(), keys.size());
+    }
+    return report(data[0], data + 2, (size < 2) ? 0 : (size - 2));
+}
+
+std::string KeyDecoder::type(uint8_t usage, uint8_t modifiers)
+{
+    // Ctrl, left Alt or GUI make it a shortcut rather than text.
+    if (0 != (modifiers & ~textModifiers))
+    {
+        return std::string();
+    }
+    return type_(stroke_(usage, modifiers));
+}
+
+bool KeyDecoder::character(uint8_t usage, uint8_t modifiers, uint32_t & codePoint) const
+{
+    auto const character = characters_.find(stroke_(usage, modifiers));
+    if (characters_.end() == character)
+    {
+        return false;
+    }
+    codePoint = character->second;
+    return true;
+}
+
+std::string KeyDecoder::keyName(uint8_t usage) const
+{
+    for (KeyName const & keyName : keyNames)
+    {
+        if (usage == keyName.usage)
+        {
+            return keyName.name;
+        }
+    }
+    if ((0x3a <= usage) && (usage <= 0x45))
+    {
+        return "F" + std::to_string(usage - 0x39);
+    }
+    std::string name;
+    auto const character = characters_.find(stroke_(usage, 0));
+    if ((characters_.end() != character) && (' ' < character->second) && (0x7f != character->second))
+    {
+        appendUtf8(name, character->second);
+        return name;
+    }
+    auto const deadKey = deadKeys_.find(stroke_(usage, 0));
+    if (deadKeys_.end() != deadKey)
+    {
+        auto const own = deadKey->second.find(' ');
+        if (deadKey->second.end() != own)
+        {
+            appendUtf8(name, own->second);
+            return name;
+        }
+    }
+    char hex[8];
+    snprintf(hex, sizeof(hex), "0x%02x", usage);
+    return hex;
+}
+
+void KeyDecoder::appendUtf8(std::string & text, uint32_t codePoint)
+{
+    if (codePoint < 0x80)
+    {
+        text += static_cast<char>(codePoint);
+    }
+    else if (codePoint < 0x800)
+    {
+        text += static_cast<char>(0xc0 | (codePoint >> 6));
+        text += static_cast<char>(0x80 | (codePoint & 0x3f));
+    }
+    else if (codePoint < 0x10000)
+    {
+        text += static_cast<char>(0xe0 | (codePoint >> 12));
+        text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+        text += static_cast<char>(0x80 | (codePoint & 0x3f));
+    }
+    else
+    {
+        text += static_cast<char>(0xf0 | (codePoint >> 18));
+        text += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+        text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+        text += static_cast<char>(0x80 | (codePoint & 0x3f));
+    }
+}
+
+std::vector<uint32_t> KeyDecoder::decodeUtf8(std::string const & text)
+{
+    std::vector<uint32_t> codePoints;
+    for (size_t i = 0; i < text.size();)
+    {
+        uint8_t const lead = static_cast<uint8_t>(text[i++]);
+        uint8_t const length = (lead < 0x80) ? 0 : ((lead >= 0xf0) ? 3 : ((lead >= 0xe0) ? 2 : ((lead >= 0xc0) ? 1 : 0xff)));
+        if ((0xff == length) || (0xf8 <= lead))
+        {
+            codePoints.push_back(0xfffd);
+            continue;
+        }
+        uint32_t codePoint = lead & ((0 == length) ? 0x7f : (0x3f >> length));
+        uint8_t j = 0;
+        for (; (j < length) && (i < text.size()) && (0x80 == (text[i] & 0xc0)); ++j)
+        {
+            codePoint = (codePoint << 6) | (text[i++] & 0x3f);
+        }
+        codePoints.push_back((j == length) ? codePoint : 0xfffd);
+    }
+    return codePoints;
+}
+
+uint16_t KeyDecoder::stroke_(uint8_t usage, uint8_t modifiers)
+{
+    uint8_t const shift = (modifiers & 0x22) ? 0x02 : 0;
+    return static_cast<uint16_t>((usage << 8) | shift | (modifiers & 0x40));
+}
+
+void KeyDecoder::add_(uint8_t k, uint8_t entry, uint32_t codePoint)
+{
+    uint8_t key;
+    uint8_t modifiers;
+    if (decodeLayoutKey(k, entry, key, modifiers))
+    {
+        characters_.emplace(stroke_(key, modifiers), codePoint);
+    }
+}
+
+// type_() returns the text a newly pressed stroke produces.
+std::string KeyDecoder::type_(uint16_t stroke)
+{
+    std::string text;
+    if (deadKeyPending_)
+    {
+        deadKeyPending_ = false;
+        std::map<uint32_t, uint32_t> const & combinations = deadKeys_[pendingDeadKey_];
+        auto const character = characters_.find(stroke);
+        if (characters_.end() != character)
+        {
+            auto const combined = combinations.find(character->second);
+            if (combinations.end() != combined)
+            {
+                appendUtf8(text, combined->second);
+                return text;
+            }
+        }
+        // No combination: the dead key types itself, then the stroke counts on its own.
+        auto const own = combinations.find(' ');
+        if (combinations.end() != own)
+        {
+            appendUtf8(text, own->second);
+        }
+    }
+
+    if (deadKeys_.end() != deadKeys_.find(stroke))
+    {
+        deadKeyPending_ = true;
+        pendingDeadKey_ = stroke;
+        return text;
+    }
+    auto const character = characters_.find(stroke);
+    if (characters_.end() != character)
+    {
+        appendUtf8(text, character->second);
+    }
+    return text;
+}
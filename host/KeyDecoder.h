@@ -0,0 +1,72 @@
+/*
+  KeyDecoder.h
+
+  Turns a sequence of keyboard reports back into text, the way a host
+  with the given layout would: each key newly pressed in a report types the
+  character the layout tables map it to under the Shift and AltGr state of
+  that report, dead keys combine with the following character.
+*/
+
+#ifndef KEY_DECODER_h
+#define KEY_DECODER_h
+
+#include "Layouts.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+class KeyDecoder
+{
+public:
+    explicit KeyDecoder(Layouts::NamedLayout const & layout);
+
+    struct Event
+    {
+        std::vector<uint8_t> pressed;   // usages newly down
+        std::vector<uint8_t> released;  // usages newly up
+        std::string text;               // typed by the pressed ones, UTF-8
+    };
+
+    // Feeds the next report: its modifier bits and pressed usages [0 for
+    // empty slots, may be in any order].
+    Event report(uint8_t modifiers, uint8_t const * keys, size_t count);
+
+    // Feeds a report as sent by Keyboard_: a KeyReport [8 bytes] or an
+    // NkroReport [16 bytes], see SlowKeyboard.h.
+    Event report(uint8_t const * data, size_t size);
+
+    // Returns the text one more press of usage under modifiers types,
+    // e.g. for autorepeat. Empty for shortcuts [Ctrl, left Alt or GUI].
+    std::string type(uint8_t usage, uint8_t modifiers);
+
+    // Looks up the character usage produces under modifiers, ignoring dead keys.
+    bool character(uint8_t usage, uint8_t modifiers, uint32_t & codePoint) const;
+
+    // Returns a readable name of usage, e.g. "a", "Return" or "0x65".
+    std::string keyName(uint8_t usage) const;
+
+    static void appendUtf8(std::string & text, uint32_t codePoint);
+    // Invalid sequences decode to U+FFFD.
+    static std::vector<uint32_t> decodeUtf8(std::string const & text);
+
+private:
+    // Key of a character: usage << 8 | Shift [0x02] and AltGr [0x40] bits.
+    static uint16_t stroke_(uint8_t usage, uint8_t modifiers);
+    void add_(uint8_t k, uint8_t entry, uint32_t codePoint);
+    std::string type_(uint16_t stroke);
+
+    std::map<uint16_t, uint32_t> characters_;
+    // Dead key stroke to [base character to combined character].
+    std::map<uint16_t, std::map<uint32_t, uint32_t>> deadKeys_;
+
+    std::vector<uint8_t> down_;
+    uint16_t pendingDeadKey_;
+    bool deadKeyPending_;
+};
+
+#endif
@@ -0,0 +1,53 @@
+/*
+  Layouts.h
+
+  The supported keyboard layouts by name, for the host tools.
+*/
+
+#ifndef LAYOUTS_h
+#define LAYOUTS_h
+
+#include "SlowKeyboard.h"
+
+#include <string.h>
+
+
+namespace Layouts
+{
+
+struct NamedLayout
+{
+    char const * name;
+    uint8_t const * table;
+    UnicodeKey const * unicodeKeys;
+    uint8_t unicodeKeyCount;
+};
+
+template <size_t N>
+constexpr NamedLayout named(char const * name, uint8_t const * table, UnicodeKey const (&unicodeKeys)[N])
+{
+    return {name, table, unicodeKeys, N};
+}
+
+inline constexpr NamedLayout all[] = {named("de_DE", KeyboardLayout_de_DE, KeyboardLayout_de_DE_unicode),
+                                      {"en_US", KeyboardLayout_en_US, nullptr, 0},
+                                      named("es_ES", KeyboardLayout_es_ES, KeyboardLayout_es_ES_unicode),
+                                      named("fr_FR", KeyboardLayout_fr_FR, KeyboardLayout_fr_FR_unicode),
+                                      named("it_IT", KeyboardLayout_it_IT, KeyboardLayout_it_IT_unicode)};
+
+// Returns nullptr for unknown names.
+inline NamedLayout const * find(char const * name)
+{
+    for (NamedLayout const & layout : all)
+    {
+        if (0 == strcmp(layout.name, name))
+        {
+            return &layout;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace Layouts
+
+#endif
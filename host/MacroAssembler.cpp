@@ -0,0 +1,352 @@
+/*
+  MacroAssembler.cpp
+
+  See MacroAssembler.h.
+*/
+
+#include "MacroAssembler.h"
+
+#include "KeyDecoder.h"
+#include "Macro.h"
+#include "SlowKeyboard.h"
+#include "TimingProfile.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+namespace
+{
+
+struct KeyName
+{
+    char const * name;
+    uint8_t code;
+};
+
+KeyName constexpr keyNames[] = {{"LEFT_CTRL", KEY_LEFT_CTRL}, {"LEFT_SHIFT", KEY_LEFT_SHIFT},
+                                {"LEFT_ALT", KEY_LEFT_ALT}, {"LEFT_GUI", KEY_LEFT_GUI},
+                                {"RIGHT_CTRL", KEY_RIGHT_CTRL}, {"RIGHT_SHIFT", KEY_RIGHT_SHIFT},
+                                {"RIGHT_ALT", KEY_RIGHT_ALT}, {"RIGHT_GUI", KEY_RIGHT_GUI},
+                                {"CTRL", KEY_LEFT_CTRL}, {"SHIFT", KEY_LEFT_SHIFT}, {"ALT", KEY_LEFT_ALT},
+                                {"GUI", KEY_LEFT_GUI}, {"ALT_GR", KEY_RIGHT_ALT},
+                                {"UP_ARROW", KEY_UP_ARROW}, {"DOWN_ARROW", KEY_DOWN_ARROW},
+                                {"LEFT_ARROW", KEY_LEFT_ARROW}, {"RIGHT_ARROW", KEY_RIGHT_ARROW},
+                                {"BACKSPACE", KEY_BACKSPACE}, {"TAB", KEY_TAB}, {"RETURN", KEY_RETURN},
+                                {"ESC", KEY_ESC}, {"INSERT", KEY_INSERT}, {"DELETE", KEY_DELETE},
+                                {"PAGE_UP", KEY_PAGE_UP}, {"PAGE_DOWN", KEY_PAGE_DOWN}, {"HOME", KEY_HOME},
+                                {"END", KEY_END}, {"CAPS_LOCK", KEY_CAPS_LOCK}, {"SCROLL_LOCK", KEY_SCROLL_LOCK},
+                                {"NUM_LOCK", KEY_NUM_LOCK}, {"SPACE", ' '},
+                                {"F1", KEY_F1}, {"F2", KEY_F2}, {"F3", KEY_F3}, {"F4", KEY_F4},
+                                {"F5", KEY_F5}, {"F6", KEY_F6}, {"F7", KEY_F7}, {"F8", KEY_F8},
+                                {"F9", KEY_F9}, {"F10", KEY_F10}, {"F11", KEY_F11}, {"F12", KEY_F12},
+                                {"F13", KEY_F13}, {"F14", KEY_F14}, {"F15", KEY_F15}, {"F16", KEY_F16},
+                                {"F17", KEY_F17}, {"F18", KEY_F18}, {"F19", KEY_F19}, {"F20", KEY_F20},
+                                {"F21", KEY_F21}, {"F22", KEY_F22}, {"F23", KEY_F23}, {"F24", KEY_F24}};
+
+// Returns true if c would be taken as code instead of being typed.
+bool isCode(uint8_t c)
+{
+    return ((Macro::Code::press <= c) && (c <= Macro::Code::defaultReportDelay)) || (Macro::Code::unicode == c) ||
+           (Macro::Code::timingProfile == c);
+}
+
+bool parseKey(std::string const & name, uint8_t & code)
+{
+    for (KeyName const & key : keyNames)
+    {
+        if (name == key.name)
+        {
+            code = key.code;
+            return true;
+        }
+    }
+    if ((1 == name.size()) && (' ' < name[0]) && (name[0] < 0x7f))
+    {
+        code = static_cast<uint8_t>(name[0]);
+        return true;
+    }
+    return false;
+}
+
+bool parseNumber(std::string const & text, unsigned long & value)
+{
+    char * end = nullptr;
+    value = strtoul(text.c_str(), &end, 10);
+    return !text.empty() && ('\0' == *end);
+}
+
+// Appends text to code, unescaped and with characters beyond ASCII by code point.
+bool addText(std::string const & text, std::vector<uint8_t> & code, std::string & error)
+{
+    std::string unescaped;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        char c = text[i];
+        if ('\\' == c)
+        {
+            if (i + 1 == text.size())
+            {
+                error = "\\ at the end of the line";
+                return false;
+            }
+            switch (text[++i])
+            {
+            case 'n':
+                c = '\n';
+                break;
+            case 't':
+                c = '\t';
+                break;
+            case 'b':
+                c = '\b';
+                break;
+            case '\\':
+                c = '\\';
+                break;
+            default:
+                error = std::string("unknown escape \\") + text[i];
+                return false;
+            }
+        }
+        unescaped += c;
+    }
+
+    for (uint32_t const codePoint : KeyDecoder::decodeUtf8(unescaped))
+    {
+        if (codePoint >= 0x80)
+        {
+            std::string utf8;
+            KeyDecoder::appendUtf8(utf8, codePoint);
+            code.push_back(Macro::Code::unicode);
+            code.insert(code.end(), utf8.begin(), utf8.end());
+        }
+        else if ((0 == codePoint) || isCode(static_cast<uint8_t>(codePoint)))
+        {
+            error = "control character in text";
+            return false;
+        }
+        else
+        {
+            code.push_back(static_cast<uint8_t>(codePoint));
+        }
+    }
+    return true;
+}
+
+// Assembles one line without its keyword into code.
+bool addLine(std::string const & keyword, std::string const & argument,
+             std::vector<uint8_t> & code, std::string & error)
+{
+    uint8_t key;
+    unsigned long value;
+    if ("text" == keyword)
+    {
+        return addText(argument, code, error);
+    }
+    if (("key" == keyword) || ("press" == keyword) || ("release" == keyword))
+    {
+        if (!parseKey(argument, key))
+        {
+            error = "unknown key " + argument;
+            return false;
+        }
+        if ("press" == keyword)
+        {
+            code.push_back(Macro::Code::press);
+        }
+        else if ("release" == keyword)
+        {
+            code.push_back(Macro::Code::release);
+        }
+        code.push_back(key);
+        return true;
+    }
+    if ("releaseall" == keyword)
+    {
+        code.push_back(Macro::Code::releaseAll);
+        return true;
+    }
+    if ("chord" == keyword)
+    {
+        std::vector<uint8_t> keys;
+        size_t begin = 0;
+        while (begin <= argument.size())
+        {
+            size_t end = argument.find('+', begin + 1);    // "CTRL++" presses +
+            if (std::string::npos == end)
+            {
+                end = argument.size();
+            }
+            if (!parseKey(argument.substr(begin, end - begin), key))
+            {
+                error = "unknown key " + argument.substr(begin, end - begin);
+                return false;
+            }
+            keys.push_back(key);
+            begin = end + 1;
+        }
+        if (Macro::maximumChordKeys < keys.size())
+        {
+            error = "too many keys in chord";
+            return false;
+        }
+        code.push_back(Macro::Code::chord);
+        code.push_back(static_cast<uint8_t>(keys.size()));
+        code.insert(code.end(), keys.begin(), keys.end());
+        return true;
+    }
+    if ("delay" == keyword)
+    {
+        if (!parseNumber(argument, value))
+        {
+            error = "delay needs milliseconds";
+            return false;
+        }
+        unsigned long units = (value + Macro::delayUnitMs - 1) / Macro::delayUnitMs;
+        while (0 < units)
+        {
+            unsigned long const step = (units < 0xff) ? units : 0xff;
+            code.push_back(Macro::Code::delay);
+            code.push_back(static_cast<uint8_t>(step));
+            units -= step;
+        }
+        return true;
+    }
+    if ("pace" == keyword)
+    {
+        if ("default" == argument)
+        {
+            code.push_back(Macro::Code::defaultReportDelay);
+            return true;
+        }
+        if (!parseNumber(argument, value))
+        {
+            error = "pace needs microseconds or default";
+            return false;
+        }
+        unsigned long const units = (value + Macro::reportDelayUnitUs / 2) / Macro::reportDelayUnitUs;
+        if ((0 == units) || (0xff < units))
+        {
+            error = "pace out of range [100 - 25500us]";
+            return false;
+        }
+        code.push_back(Macro::Code::reportDelay);
+        code.push_back(static_cast<uint8_t>(units));
+        return true;
+    }
+    if ("profile" == keyword)
+    {
+        uint8_t const index = TimingProfiles::find(argument.c_str());
+        if (TimingProfiles::count <= index)
+        {
+            error = "unknown timing profile " + argument;
+            return false;
+        }
+        code.push_back(Macro::Code::timingProfile);
+        code.push_back(index + 1);
+        return true;
+    }
+    error = "unknown keyword " + keyword;
+    return false;
+}
+
+} // namespace
+
+
+namespace MacroAssembler
+{
+
+bool assemble(std::string const & source, std::vector<Entry> & macros, std::string & error)
+{
+    size_t lineNumber = 0;
+    size_t begin = 0;
+    while (begin < source.size())
+    {
+        size_t end = source.find('\n', begin);
+        if (std::string::npos == end)
+        {
+            end = source.size();
+        }
+        std::string line = source.substr(begin, end - begin);
+        begin = end + 1;
+        ++lineNumber;
+        if (!line.empty() && ('\r' == line.back()))
+        {
+            line.pop_back();
+        }
+
+        size_t const first = line.find_first_not_of(" \t");
+        if ((std::string::npos == first) || ('#' == line[first]))
+        {
+            continue;
+        }
+        size_t const keywordEnd = line.find_first_of(" \t", first);
+        std::string const keyword = line.substr(first, keywordEnd - first);
+        // text keeps everything after the single separating space.
+        std::string argument = (std::string::npos == keywordEnd) ? "" : line.substr(keywordEnd + 1);
+        if ("text" != keyword)
+        {
+            size_t const argumentBegin = argument.find_first_not_of(" \t");
+            size_t const argumentEnd = argument.find_last_not_of(" \t");
+            argument = (std::string::npos == argumentBegin) ? "" : argument.substr(argumentBegin, argumentEnd - argumentBegin + 1);
+        }
+
+        if ("macro" == keyword)
+        {
+            macros.push_back({argument, {}});
+            continue;
+        }
+        if (macros.empty())
+        {
+            macros.push_back({"", {}});
+        }
+        std::string lineError;
+        if (!addLine(keyword, argument, macros.back().code, lineError))
+        {
+            error = "line " + std::to_string(lineNumber) + ": " + lineError;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string literal(std::vector<uint8_t> const & code)
+{
+    std::string text = "\"";
+    bool afterHex = false;
+    for (uint8_t const c : code)
+    {
+        char escaped[8];
+        if (('"' == c) || ('\\' == c))
+        {
+            snprintf(escaped, sizeof(escaped), "\\%c", c);
+        }
+        else if ('\n' == c)
+        {
+            snprintf(escaped, sizeof(escaped), "\\n");
+        }
+        else if ('\t' == c)
+        {
+            snprintf(escaped, sizeof(escaped), "\\t");
+        }
+        else if ((' ' <= c) && (c < 0x7f))
+        {
+            // A hex escape would swallow a following hex digit, so start a new literal.
+            snprintf(escaped, sizeof(escaped), (afterHex && isxdigit(c)) ? "\" \"%c" : "%c", c);
+        }
+        else
+        {
+            snprintf(escaped, sizeof(escaped), "\\x%02x", c);
+            text += escaped;
+            afterHex = true;
+            continue;
+        }
+        text += escaped;
+        afterHex = false;
+    }
+    return text + "\"";
+}
+
+} // namespace MacroAssembler
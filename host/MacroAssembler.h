@@ -0,0 +1,50 @@
+/*
+  MacroAssembler.h
+
+  Assembles the byte code of Macro.h from a line based source:
+
+    # comment
+    macro NAME              starts the next macro [the name is optional]
+    text TEXT               types the rest of the line [\n \t \b \\ escapes, UTF-8]
+    key KEY                 types a special key or a character
+    press KEY               presses it until release, releaseall or the macro ends
+    release KEY
+    releaseall
+    chord KEY+KEY+...       e.g. chord LEFT_CTRL+LEFT_ALT+DELETE
+    delay MS                rounded up to 10ms
+    pace US | pace default  report delay from here on, rounded to 100us
+    profile NAME            timing profile from here on [standard, fast, careful, bios]
+
+  KEY is the name of a KEY_* code without the prefix [RETURN, LEFT_CTRL,
+  F5, ...], CTRL, SHIFT, ALT, GUI or ALT_GR, SPACE or a single ASCII
+  character. Characters beyond ASCII are entered by code point, like
+  Keyboard_::writeUnicode().
+*/
+
+#ifndef MACRO_ASSEMBLER_h
+#define MACRO_ASSEMBLER_h
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+
+namespace MacroAssembler
+{
+
+struct Entry
+{
+    std::string name;
+    std::vector<uint8_t> code;
+};
+
+// Returns false and describes the first error [with its line] in error.
+bool assemble(std::string const & source, std::vector<Entry> & macros, std::string & error);
+
+// Returns code as C++ string literal for KEYBOARD_COMPRESS_MACROS.
+std::string literal(std::vector<uint8_t> const & code);
+
+} // namespace MacroAssembler
+
+#endif
@@ -0,0 +1,40 @@
+/*
+  TraceDump.cpp
+
+  See TraceDump.h.
+*/
+
+#include "TraceDump.h"
+
+
+namespace TraceDump
+{
+
+bool parse(std::vector<uint8_t> const & dump, std::vector<Entry> & entries)
+{
+    if ((dump.size() < 3) || (dump.size() != 3 + dump[2] * (2 + static_cast<size_t>(dump[0]))))
+    {
+        return false;
+    }
+    size_t const reportSize = dump[0];
+    unsigned long const timeUnitUs = 1ul << dump[1];
+    size_t const count = dump[2];
+
+    entries.clear();
+    uint64_t timeUs = 0;
+    uint16_t previousTime = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint8_t const * const entry = dump.data() + 3 + i * (2 + reportSize);
+        uint16_t const time = entry[0] | (entry[1] << 8);
+        if (0 < i)
+        {
+            timeUs += static_cast<uint16_t>(time - previousTime) * timeUnitUs;
+        }
+        previousTime = time;
+        entries.push_back({timeUs, std::vector<uint8_t>(entry + 2, entry + 2 + reportSize)});
+    }
+    return true;
+}
+
+} // namespace TraceDump
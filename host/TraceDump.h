@@ -0,0 +1,33 @@
+/*
+  TraceDump.h
+
+  Parses the dump of a ReportTrace as sent by the trace command [see
+  MessageProtocol.h]. The 16 bit time stamps are unwrapped into the time
+  since the first report, so pauses longer than the wrap around appear
+  shortened.
+*/
+
+#ifndef TRACE_DUMP_h
+#define TRACE_DUMP_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+
+namespace TraceDump
+{
+
+struct Entry
+{
+    uint64_t timeUs;
+    std::vector<uint8_t> report;
+};
+
+// Returns false if dump is not a trace dump.
+bool parse(std::vector<uint8_t> const & dump, std::vector<Entry> & entries);
+
+} // namespace TraceDump
+
+#endif
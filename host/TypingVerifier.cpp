@@ -0,0 +1,84 @@
+/*
+  TypingVerifier.cpp
+
+  See TypingVerifier.h.
+*/
+
+#include "TypingVerifier.h"
+
+#include <algorithm>
+
+
+namespace TypingVerifier
+{
+
+std::vector<Issue> compare(std::vector<uint32_t> const & expected, std::vector<HostKeyboard::Character> const & typed)
+{
+    // Longest common subsequence, common[i][j] for the tails from expected[i] and typed[j].
+    size_t const columns = typed.size() + 1;
+    std::vector<uint32_t> common((expected.size() + 1) * columns, 0);
+    for (size_t i = expected.size(); 0 < i--;)
+    {
+        for (size_t j = typed.size(); 0 < j--;)
+        {
+            common[i * columns + j] = (expected[i] == typed[j].codePoint)
+                                          ? (common[(i + 1) * columns + j + 1] + 1)
+                                          : std::max(common[(i + 1) * columns + j], common[i * columns + j + 1]);
+        }
+    }
+
+    std::vector<Issue> issues;
+    size_t i = 0;
+    size_t j = 0;
+    while ((i < expected.size()) || (j < typed.size()))
+    {
+        // Of equally good alignments, take the one counting autorepeated characters as extra.
+        bool const skipRepeated = (j < typed.size()) && typed[j].repeated && (common[i * columns + j + 1] == common[i * columns + j]);
+        if (!skipRepeated && (i < expected.size()) && (j < typed.size()) && (expected[i] == typed[j].codePoint) &&
+            (common[i * columns + j] == common[(i + 1) * columns + j + 1] + 1))
+        {
+            ++i;
+            ++j;
+        }
+        else if ((j < typed.size()) && ((i == expected.size()) || (common[i * columns + j + 1] >= common[(i + 1) * columns + j])))
+        {
+            uint32_t const codePoint = typed[j].codePoint;
+            Problem problem = Problem::unexpected;
+            if (typed[j].repeated)
+            {
+                problem = Problem::repeated;
+            }
+            else if (((0 < j) && (codePoint == typed[j - 1].codePoint)) ||
+                     ((j + 1 < typed.size()) && (codePoint == typed[j + 1].codePoint)))
+            {
+                problem = Problem::duplicated;
+            }
+            issues.push_back({problem, i, codePoint, typed[j].timeUs});
+            ++j;
+        }
+        else
+        {
+            issues.push_back({Problem::dropped, i, expected[i], 0});
+            ++i;
+        }
+    }
+    return issues;
+}
+
+char const * problemName(Problem problem)
+{
+    switch (problem)
+    {
+    case Problem::dropped:
+        return "dropped";
+    case Problem::duplicated:
+        return "duplicated";
+    case Problem::repeated:
+        return "repeated";
+    case Problem::unexpected:
+        return "unexpected";
+    }
+    return "unknown";
+}
+
+} // namespace TypingVerifier
@@ -0,0 +1,47 @@
+/*
+  TypingVerifier.h
+
+  Compares the characters a HostKeyboard received with the text meant to
+  be typed. The difference is aligned with the fewest edits and each
+  edit classified: expected characters missing are dropped, extra ones
+  produced by autorepeat are repeated, extra copies of the character
+  before them are duplicated and anything else is unexpected.
+*/
+
+#ifndef TYPING_VERIFIER_h
+#define TYPING_VERIFIER_h
+
+#include "HostKeyboard.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+
+namespace TypingVerifier
+{
+
+enum class Problem : uint8_t
+{
+    dropped,
+    duplicated,
+    repeated,
+    unexpected
+};
+
+struct Issue
+{
+    Problem problem;
+    size_t position;    // in the expected text
+    uint32_t codePoint;
+    uint64_t timeUs;    // when typed, for all but dropped
+};
+
+std::vector<Issue> compare(std::vector<uint32_t> const & expected, std::vector<HostKeyboard::Character> const & typed);
+
+char const * problemName(Problem problem);
+
+} // namespace TypingVerifier
+
+#endif
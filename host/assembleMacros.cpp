@@ -0,0 +1,106 @@
+/*
+  assembleMacros
+
+  Assembles macros [see MacroAssembler.h for the source, Macro.h for the
+  byte code] into string literals for KEYBOARD_COMPRESS_MACROS in
+  main.cpp, or the code of one of them for uploading:
+
+  Usage: assembleMacros [--binary INDEX] [FILE]
+
+  Without FILE, the source is read from stdin. --binary writes the code of
+  the macro INDEX [counting from 0] to stdout as it is, e.g. for
+  uploadMessages PORT write ID -. The sizes go to stderr.
+*/
+
+#include "MacroAssembler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+
+static int usage()
+{
+    fprintf(stderr, "Usage: assembleMacros [--binary INDEX] [FILE]\n");
+    return 2;
+}
+
+int main(int argc, char ** argv)
+{
+    char const * fileName = nullptr;
+    long binaryIndex = -1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if ((0 == strcmp(argv[i], "--binary")) && (i + 1 < argc))
+        {
+            binaryIndex = strtol(argv[++i], nullptr, 0);
+        }
+        else if ((nullptr == fileName) && ('-' != argv[i][0]))
+        {
+            fileName = argv[i];
+        }
+        else
+        {
+            return usage();
+        }
+    }
+
+    FILE * const file = (nullptr != fileName) ? fopen(fileName, "rb") : stdin;
+    if (nullptr == file)
+    {
+        fprintf(stderr, "Cannot open %s\n", fileName);
+        return 1;
+    }
+    std::string source;
+    int c;
+    while (EOF != (c = fgetc(file)))
+    {
+        source += static_cast<char>(c);
+    }
+    if (stdin != file)
+    {
+        fclose(file);
+    }
+
+    std::vector<MacroAssembler::Entry> macros;
+    std::string error;
+    if (!MacroAssembler::assemble(source, macros, error))
+    {
+        fprintf(stderr, "%s: %s\n", (nullptr != fileName) ? fileName : "stdin", error.c_str());
+        return 1;
+    }
+
+    size_t total = 0;
+    for (MacroAssembler::Entry const & macro : macros)
+    {
+        total += macro.code.size();
+    }
+    fprintf(stderr, "%zu macros, %zu bytes [before compression]\n", macros.size(), total);
+
+    if (0 <= binaryIndex)
+    {
+        if (macros.size() <= static_cast<size_t>(binaryIndex))
+        {
+            fprintf(stderr, "There is no macro %ld\n", binaryIndex);
+            return 1;
+        }
+        std::vector<uint8_t> const & code = macros[binaryIndex].code;
+        fwrite(code.data(), 1, code.size(), stdout);
+        return 0;
+    }
+
+    for (size_t i = 0; i < macros.size(); ++i)
+    {
+        printf("    %s%s", MacroAssembler::literal(macros[i].code).c_str(), (i + 1 < macros.size()) ? "," : "");
+        if (!macros[i].name.empty())
+        {
+            printf("  // %s", macros[i].name.c_str());
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,282 @@
+/*
+  benchmark
+
+  Measures typing throughput of Keyboard_ on the host build for every
+  combination of corpus, layout, typing mode and report pacing. Prints one
+  CSV line per combination:
+
+    corpus,layout,typing,pacing,characters,unmapped,reports,reportsPerCharacter,virtualTimeUs,cpuNsPerCharacter
+
+  virtualTimeUs is the simulated time from the first report until the last
+  one was sent, cpuNsPerCharacter the host's real time spent in write()
+  [i.e. press() and release()] per character without the time simulating
+  the clock and the USB host [measured by HalHost::replay()], the fastest
+  of repetitions runs - only comparable between runs on the same machine.
+
+  Usage: benchmark [--baseline file.csv]
+
+  With --baseline, the results are compared to a previous output and the
+  exit code is 1 if any combination needs more reports or virtual time, or
+  more than cpuTolerance times the CPU time.
+*/
+
+#include "HalHost.h"
+#include "Layouts.h"
+#include "SlowKeyboard.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+struct Corpus
+{
+    char const * name;
+    char const * text;
+};
+
+Corpus constexpr corpora[] = {
+    {"passwords",
+     "Tr0ub4dor&3\n"
+     "correct horse battery staple\n"
+     "P@ssw0rd!2024\n"
+     "aaBBccDDee11\n"
+     "x7#Kq9$mZ2%vL\n"},
+    {"prose",
+     "It was the best of times, it was the worst of times, it was the age of wisdom, "
+     "it was the age of foolishness, it was the epoch of belief, it was the epoch of "
+     "incredulity, it was the season of Light, it was the season of Darkness, it was "
+     "the spring of hope, it was the winter of despair, we had everything before us, "
+     "we had nothing before us, we were all going direct to Heaven, we were all going "
+     "direct the other way - in short, the period was so far like the present period, "
+     "that some of its noisiest authorities insisted on its being received, for good "
+     "or for evil, in the superlative degree of comparison only.\n"},
+    {"symbols",
+     "192.168.178.1:8080/api?v=2&id=4711\n"
+     "if (x[3] != {a|b}) { y = (c + d) * 7 % 5; }\n"
+     "$HOME/~user/.config @ #1 ^ `ls -la` \"quoted\" 'single' <tag> _under_\n"
+     "2024-06-30 23:59:59 +0200; 3.14159265; 0x7fff; 1e-9; 42/7=6\n"},
+};
+
+struct Typing
+{
+    char const * name;
+    bool rollover;
+};
+
+Typing constexpr typings[] = {
+    {"pressRelease", false},
+    {"rollover", true},
+};
+
+struct Pacing
+{
+    char const * name;
+    Keyboard_::ReportPacing pacing;
+    unsigned long minimumReportDelayUs;
+    uint8_t framesPerReport;
+};
+
+Pacing constexpr pacings[] = {
+    {"fixed16667", Keyboard_::ReportPacing::fixedDelay, 16667, 1},
+    {"fixed8000", Keyboard_::ReportPacing::fixedDelay, 8000, 1},
+    {"drained", Keyboard_::ReportPacing::endpointDrained, 0, 1},
+    {"frames2", Keyboard_::ReportPacing::usbFrames, 0, 2},
+};
+
+// Each combination is typed this often, the CPU time is the shortest.
+unsigned constexpr repetitions = 50;
+// Timing on a PC is noisy, so only more than this factor counts as slower.
+double constexpr cpuTolerance = 2.0;
+
+struct Result
+{
+    size_t characters;
+    size_t unmapped;
+    size_t reports;
+    uint64_t virtualTimeUs;
+    double cpuNsPerCharacter;
+};
+
+// Starts on a whole second [aligned to USB frames] with the keyboard idle
+// for long enough that the first report goes out right away.
+void startOnWholeSecond()
+{
+    HalHost::advanceUs(2000000 - HalHost::nowUs() % 1000000);
+}
+
+double nsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Types corpus once and returns the real time it took. Records the calls
+// simulating the clock and the USB host to calls if not nullptr.
+double type(Keyboard_ & keyboard, Corpus const & corpus, uint8_t const * layout, Typing const & typing, Pacing const & pacing,
+            std::vector<HalHost::Call> * calls, size_t & unmapped)
+{
+    HalHost::reset();
+    keyboard.rolloverTyping = typing.rollover;
+    keyboard.reportPacing = pacing.pacing;
+    keyboard.minimumReportDelayUs = pacing.minimumReportDelayUs;
+    keyboard.framesPerReport = pacing.framesPerReport;
+    keyboard.begin(layout);
+    startOnWholeSecond();
+
+    HalHost::recordCalls(calls);
+    unmapped = 0;
+    auto const start = std::chrono::steady_clock::now();
+    for (char const * c = corpus.text; '\0' != *c; ++c)
+    {
+        if (0 == keyboard.write(static_cast<uint8_t>(*c)))
+        {
+            ++unmapped;
+            keyboard.clearWriteError();
+        }
+    }
+    keyboard.flush();
+    double const ns = nsSince(start);
+    HalHost::recordCalls(nullptr);
+    keyboard.end();
+    return ns;
+}
+
+// Runs the same simulation as type() without Keyboard_ and returns the real time it took.
+double simulate(std::vector<HalHost::Call> const & calls)
+{
+    HalHost::reset();
+    startOnWholeSecond();
+    auto const start = std::chrono::steady_clock::now();
+    HalHost::replay(calls);
+    return nsSince(start);
+}
+
+Result run(Keyboard_ & keyboard, Corpus const & corpus, uint8_t const * layout, Typing const & typing, Pacing const & pacing)
+{
+    Result result = {};
+    std::vector<HalHost::Call> calls;
+    type(keyboard, corpus, layout, typing, pacing, &calls, result.unmapped);
+    std::vector<HalHost::Report> const & reports = HalHost::reports();
+    result.characters = strlen(corpus.text);
+    result.reports = reports.size();
+    result.virtualTimeUs = reports.empty() ? 0 : (reports.back().timeUs - reports.front().timeUs);
+
+    // Alternating, so both see the machine in the same state.
+    double typingNs = 0.0;
+    double simulationNs = 0.0;
+    for (unsigned i = 0; i < repetitions; ++i)
+    {
+        size_t unmapped;
+        double const ns = type(keyboard, corpus, layout, typing, pacing, nullptr, unmapped);
+        typingNs = ((0 == i) || (ns < typingNs)) ? ns : typingNs;
+        double const replayNs = simulate(calls);
+        simulationNs = ((0 == i) || (replayNs < simulationNs)) ? replayNs : simulationNs;
+    }
+    result.cpuNsPerCharacter = ((typingNs > simulationNs) ? (typingNs - simulationNs) : 0.0) / result.characters;
+    return result;
+}
+
+std::string key(char const * corpus, char const * layout, char const * typing, char const * pacing)
+{
+    return std::string(corpus) + ',' + layout + ',' + typing + ',' + pacing;
+}
+
+struct Baseline
+{
+    size_t reports;
+    uint64_t virtualTimeUs;
+    double cpuNsPerCharacter;
+};
+
+// Reads the output of a previous run, keyed by corpus,layout,typing,pacing.
+bool readBaseline(char const * path, std::map<std::string, Baseline> & baseline)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        return false;
+    }
+    std::string line;
+    std::getline(file, line); // header
+    while (std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        std::string field[10];
+        for (std::string & f : field)
+        {
+            std::getline(fields, f, ',');
+        }
+        baseline[key(field[0].c_str(), field[1].c_str(), field[2].c_str(), field[3].c_str())] =
+            Baseline{std::stoul(field[6]), std::stoull(field[8]), std::stod(field[9])};
+    }
+    return true;
+}
+
+} // namespace
+
+
+int main(int argc, char ** argv)
+{
+    std::map<std::string, Baseline> baseline;
+    if ((3 == argc) && (0 == strcmp(argv[1], "--baseline")))
+    {
+        if (!readBaseline(argv[2], baseline))
+        {
+            fprintf(stderr, "Cannot read %s\n", argv[2]);
+            return 2;
+        }
+    }
+    else if (1 != argc)
+    {
+        fprintf(stderr, "Usage: benchmark [--baseline file.csv]\n");
+        return 2;
+    }
+
+    Keyboard_ & keyboard = Keyboard;
+    bool regression = false;
+
+    printf("corpus,layout,typing,pacing,characters,unmapped,reports,reportsPerCharacter,virtualTimeUs,cpuNsPerCharacter\n");
+    for (Corpus const & corpus : corpora)
+    {
+        for (Layouts::NamedLayout const & layout : Layouts::all)
+        {
+            for (Typing const & typing : typings)
+            {
+                for (Pacing const & pacing : pacings)
+                {
+                    Result const result = run(keyboard, corpus, layout.table, typing, pacing);
+                    printf("%s,%s,%s,%s,%zu,%zu,%zu,%.3f,%llu,%.1f\n",
+                           corpus.name, layout.name, typing.name, pacing.name,
+                           result.characters, result.unmapped, result.reports,
+                           static_cast<double>(result.reports) / result.characters,
+                           static_cast<unsigned long long>(result.virtualTimeUs),
+                           result.cpuNsPerCharacter);
+
+                    auto const previous = baseline.find(key(corpus.name, layout.name, typing.name, pacing.name));
+                    if ((baseline.end() != previous) &&
+                            ((previous->second.reports < result.reports) || (previous->second.virtualTimeUs < result.virtualTimeUs) ||
+                             (previous->second.cpuNsPerCharacter * cpuTolerance < result.cpuNsPerCharacter)))
+                    {
+                        fprintf(stderr, "REGRESSION %s: %zu reports [was %zu], %llu us [was %llu], %.1f ns per character [was %.1f]\n",
+                                previous->first.c_str(), result.reports, previous->second.reports,
+                                static_cast<unsigned long long>(result.virtualTimeUs),
+                                static_cast<unsigned long long>(previous->second.virtualTimeUs),
+                                result.cpuNsPerCharacter, previous->second.cpuNsPerCharacter);
+                        regression = true;
+                    }
+                }
+            }
+        }
+    }
+
+    return regression ? 1 : 0;
+}
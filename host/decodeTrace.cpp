@@ -0,0 +1,144 @@
+/*
+  decodeTrace
+
+  Decodes a report trace dumped from the device [see ReportTrace.h and
+  uploadMessages PORT trace] into key events and the text a host with the
+  given layout would have received.
+
+  Usage: decodeTrace [--layout xx_YY] [FILE]
+
+  Without FILE, the dump is read from stdin. Each report is printed with
+  its time since the first one, the time since the previous one, the keys
+  pressed [+] and released [-] and the text typed. A report equal to its
+  predecessor is marked, as the host ignores it.
+*/
+
+#include "KeyDecoder.h"
+#include "Layouts.h"
+#include "TraceDump.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+
+// Makes control characters visible for printing in quotes.
+static std::string escaped(std::string const & text)
+{
+    std::string result;
+    for (char const c : text)
+    {
+        switch (c)
+        {
+        case '\n':
+            result += "\\n";
+            break;
+        case '\t':
+            result += "\\t";
+            break;
+        case '\b':
+            result += "\\b";
+            break;
+        default:
+            result += c;
+            break;
+        }
+    }
+    return result;
+}
+
+static int usage()
+{
+    fprintf(stderr, "Usage: decodeTrace [--layout xx_YY] [FILE]\n");
+    return 2;
+}
+
+int main(int argc, char ** argv)
+{
+    Layouts::NamedLayout const * layout = Layouts::find("en_US");
+    char const * fileName = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if ((0 == strcmp(argv[i], "--layout")) && (i + 1 < argc))
+        {
+            layout = Layouts::find(argv[++i]);
+            if (nullptr == layout)
+            {
+                fprintf(stderr, "Unknown layout %s\n", argv[i]);
+                return 2;
+            }
+        }
+        else if ((nullptr == fileName) && ('-' != argv[i][0]))
+        {
+            fileName = argv[i];
+        }
+        else
+        {
+            return usage();
+        }
+    }
+
+    FILE * const file = (nullptr == fileName) ? stdin : fopen(fileName, "rb");
+    if (nullptr == file)
+    {
+        fprintf(stderr, "Cannot open %s\n", fileName);
+        return 1;
+    }
+    std::vector<uint8_t> dump;
+    int c;
+    while (EOF != (c = fgetc(file)))
+    {
+        dump.push_back(static_cast<uint8_t>(c));
+    }
+
+    std::vector<TraceDump::Entry> entries;
+    if (!TraceDump::parse(dump, entries))
+    {
+        fprintf(stderr, "Not a trace dump\n");
+        return 1;
+    }
+    size_t const reportSize = dump[0];
+
+    KeyDecoder decoder(*layout);
+    std::string text;
+    uint8_t const * previous = nullptr;
+    uint64_t previousUs = 0;
+    printf("%10s %9s  %-*s  %s\n", "ms", "+ms", static_cast<int>(3 * reportSize - 1), "report", "keys");
+    for (TraceDump::Entry const & entry : entries)
+    {
+        uint8_t const * const report = entry.report.data();
+        printf("%10.3f %9.3f  ", entry.timeUs / 1000.0, (entry.timeUs - previousUs) / 1000.0);
+        previousUs = entry.timeUs;
+        for (size_t j = 0; j < reportSize; ++j)
+        {
+            printf("%02x%s", report[j], (j + 1 < reportSize) ? " " : "  ");
+        }
+
+        KeyDecoder::Event const event = decoder.report(report, reportSize);
+        for (uint8_t const usage : event.released)
+        {
+            printf("-%s ", decoder.keyName(usage).c_str());
+        }
+        for (uint8_t const usage : event.pressed)
+        {
+            printf("+%s ", decoder.keyName(usage).c_str());
+        }
+        if (!event.text.empty())
+        {
+            printf("\"%s\"", escaped(event.text).c_str());
+        }
+        if ((nullptr != previous) && (0 == memcmp(previous, report, reportSize)))
+        {
+            printf("[repeated]");
+        }
+        printf("\n");
+
+        text += event.text;
+        previous = report;
+    }
+    printf("\n%s\n", text.c_str());
+    return 0;
+}
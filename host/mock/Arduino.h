@@ -0,0 +1,22 @@
+/*
+  Arduino.h
+
+  Minimal stand-in for the Arduino core in the host build. It only provides
+  what the sources use besides Hal.h: the integer types, Print and the
+  PROGMEM / F() annotations, which are no-ops on the host.
+*/
+
+#ifndef ARDUINO_h
+#define ARDUINO_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "Print.h"
+
+#define PROGMEM
+
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+#endif
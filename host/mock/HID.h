@@ -0,0 +1,13 @@
+/*
+  HID.h
+
+  Stand-in for the PluggableUSB HID library in the host build - the host
+  side of the USB keyboard is mocked by host/HalHost.cpp.
+*/
+
+#ifndef HID_h
+#define HID_h
+
+#include <Arduino.h>
+
+#endif
@@ -0,0 +1,63 @@
+/*
+  Print.h
+
+  Host build version of the Arduino core's Print, restricted to the
+  members the sources use.
+*/
+
+#ifndef Print_h
+#define Print_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+class __FlashStringHelper;
+
+class Print
+{
+private:
+    int write_error;
+
+protected:
+    void setWriteError(int err = 1) { write_error = err; }
+
+public:
+    Print() : write_error(0) {}
+    virtual ~Print() {}
+
+    int getWriteError() { return write_error; }
+    void clearWriteError() { setWriteError(0); }
+
+    virtual size_t write(uint8_t) = 0;
+    size_t write(const char *str)
+    {
+        if (str == NULL) return 0;
+        return write((const uint8_t *)str, strlen(str));
+    }
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *buffer, size_t size)
+    {
+        return write((const uint8_t *)buffer, size);
+    }
+
+    virtual int availableForWrite() { return 0; }
+
+    size_t print(const __FlashStringHelper *);
+    size_t print(const char[]);
+    size_t print(char);
+    size_t print(unsigned long, int = 10);
+    size_t print(long, int = 10);
+    size_t print(unsigned int n, int base = 10) { return print((unsigned long)n, base); }
+    size_t print(int n, int base = 10) { return print((long)n, base); }
+
+    size_t println(const __FlashStringHelper *);
+    size_t println(const char[]);
+    size_t println(unsigned long, int = 10);
+    size_t println(long, int = 10);
+    size_t println(void);
+
+    virtual void flush() { /* Empty implementation for backward compatibility */ }
+};
+
+#endif
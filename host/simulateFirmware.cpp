@@ -0,0 +1,364 @@
+/*
+  simulateFirmware
+
+  Runs the whole firmware [setup() of main.cpp] on the virtual clock of
+  HalHost, driven by a script of button presses and USB bus states, and
+  prints the timeline followed by a summary: per press the latency until
+  the first report, when a long press was recognised [the LED turning on
+  while held], the reports sent and how long the CPU was awake until the
+  next press, then when the host configured the device and was ready for
+  input [the LED turning off] and the totals. The output is deterministic,
+  so runs of two firmware versions can be compared with diff.
+
+  Usage: simulateFirmware [--end-ms N] [--summary] [SCRIPT]
+
+  The script [stdin without SCRIPT] has one event per line, at ms since
+  power-on:
+
+    # comment
+    MS down | MS up           the button
+    MS click [HOLD]           down, and up HOLD ms later [default 80]
+    MS suspend | MS resume    the USB bus
+    MS configure [DRIVER]     the host configures the device and polls the
+                              keyboard endpoint from DRIVER ms later on
+    MS unconfigure            a bus reset or unplugging
+
+  The device is configured from power-on unless the first of the last two
+  in the script is configure.
+
+  The simulation ends at --end-ms, by default 3s after the last event.
+  --summary leaves out the timeline.
+*/
+
+#include "Hal.h"
+#include "HalHost.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+
+void setup();	// main.cpp
+
+
+namespace
+{
+
+unsigned long constexpr defaultHoldMs = 80;
+unsigned long constexpr defaultTailMs = 3000;
+
+struct Entry
+{
+    uint64_t timeUs;
+    std::string text;
+};
+
+struct Press
+{
+    uint64_t downUs;
+    uint64_t upUs;	// 0 if still held at the end
+    uint64_t sleepingUs;	// HalHost's counters at downUs
+    uint64_t poweredDownUs;
+};
+
+uint64_t startUs = 0;
+std::vector<Entry> scripted;	// as they happened
+std::vector<Press> presses;
+std::vector<uint64_t> configuredUs;
+
+void buttonDown()
+{
+    if (!Hal::buttonDown())
+    {
+        presses.push_back({HalHost::nowUs(), 0, HalHost::sleepingUs(), HalHost::poweredDownUs()});
+        scripted.push_back({HalHost::nowUs(), "button down"});
+    }
+    HalHost::setButtonDown(true);
+}
+
+void buttonUp()
+{
+    if (Hal::buttonDown())
+    {
+        presses.back().upUs = HalHost::nowUs();
+        scripted.push_back({HalHost::nowUs(), "button up"});
+    }
+    HalHost::setButtonDown(false);
+}
+
+void usbSuspended(bool suspended)
+{
+    scripted.push_back({HalHost::nowUs(), suspended ? "USB suspended" : "USB resumed"});
+    HalHost::setUsbSuspended(suspended);
+}
+
+void usbConfigured(uint64_t driverUs)
+{
+    configuredUs.push_back(HalHost::nowUs());
+    scripted.push_back({HalHost::nowUs(), "USB configured"});
+    HalHost::setUsbConfigured(true);
+    HalHost::startHostPolling(HalHost::nowUs() + driverUs);
+}
+
+void usbUnconfigured()
+{
+    scripted.push_back({HalHost::nowUs(), "USB unconfigured"});
+    HalHost::setUsbConfigured(false);
+}
+
+// Schedules the events of the script and sets lastMs to the time of the
+// last one, and startConfigured to whether the device is configured from
+// power-on. Returns false for an unknown event.
+bool schedule(FILE * file, char const * name, unsigned long & lastMs, bool & startConfigured)
+{
+    char line[256];
+    unsigned lineNumber = 0;
+    bool configurationScripted = false;
+    lastMs = 0;
+    startConfigured = true;
+    while (nullptr != fgets(line, sizeof(line), file))
+    {
+        ++lineNumber;
+        char keyword[16] = "";
+        unsigned long ms = 0;
+        unsigned long holdMs = defaultHoldMs;	// or the DRIVER ms of configure
+        int const fields = sscanf(line, "%lu %15s %lu", &ms, keyword, &holdMs);
+        char const * const first = line + strspn(line, " \t\r\n");
+        if (('\0' == *first) || ('#' == *first))
+        {
+            continue;
+        }
+        uint64_t const timeUs = startUs + ms * 1000ull;
+        if ((2 <= fields) && (0 == strcmp(keyword, "down")))
+        {
+            HalHost::at(timeUs, buttonDown);
+        }
+        else if ((2 <= fields) && (0 == strcmp(keyword, "up")))
+        {
+            HalHost::at(timeUs, buttonUp);
+        }
+        else if ((2 <= fields) && (0 == strcmp(keyword, "click")))
+        {
+            HalHost::at(timeUs, buttonDown);
+            HalHost::at(timeUs + holdMs * 1000ull, buttonUp);
+            ms += holdMs;
+        }
+        else if ((2 <= fields) && (0 == strcmp(keyword, "suspend")))
+        {
+            HalHost::at(timeUs, [] { usbSuspended(true); });
+        }
+        else if ((2 <= fields) && (0 == strcmp(keyword, "resume")))
+        {
+            HalHost::at(timeUs, [] { usbSuspended(false); });
+        }
+        else if ((2 <= fields) && (0 == strcmp(keyword, "configure")))
+        {
+            uint64_t const driverUs = (3 <= fields) ? holdMs * 1000ull : 0;
+            HalHost::at(timeUs, [driverUs] { usbConfigured(driverUs); });
+            startConfigured = startConfigured && configurationScripted;
+            configurationScripted = true;
+        }
+        else if ((2 <= fields) && (0 == strcmp(keyword, "unconfigure")))
+        {
+            HalHost::at(timeUs, usbUnconfigured);
+            configurationScripted = true;
+        }
+        else
+        {
+            fprintf(stderr, "%s: line %u: unknown event\n", name, lineNumber);
+            return false;
+        }
+        lastMs = std::max(lastMs, ms);
+    }
+    return true;
+}
+
+double ms(uint64_t us)
+{
+    return static_cast<double>(us) / 1000.0;
+}
+
+void printTimeline()
+{
+    std::vector<Entry> timeline = scripted;
+    for (HalHost::LedEdge const & edge : HalHost::ledEdges())
+    {
+        timeline.push_back({edge.timeUs, edge.on ? "LED on" : "LED off"});
+    }
+    for (HalHost::Report const & report : HalHost::reports())
+    {
+        std::string text = "report id " + std::to_string(report.id) + " ";
+        for (uint8_t i = 0; i < report.size; ++i)
+        {
+            char hex[4];
+            snprintf(hex, sizeof(hex), " %02x", report.data[i]);
+            text += hex;
+        }
+        timeline.push_back({report.timeUs, text});
+    }
+    std::stable_sort(timeline.begin(), timeline.end(), [](Entry const & a, Entry const & b)
+    {
+        return a.timeUs < b.timeUs;
+    });
+    for (Entry const & entry : timeline)
+    {
+        printf("%12.3f ms  %s\n", ms(entry.timeUs - startUs), entry.text.c_str());
+    }
+    printf("\n");
+}
+
+void printSummary(uint64_t endUs)
+{
+    std::vector<HalHost::Report> const & reports = HalHost::reports();
+    std::vector<HalHost::LedEdge> const & ledEdges = HalHost::ledEdges();
+    for (size_t i = 0; i < presses.size(); ++i)
+    {
+        Press const & press = presses[i];
+        bool const last = (i + 1 == presses.size());
+        uint64_t const untilUs = last ? endUs : presses[i + 1].downUs;
+        uint64_t const sleepingUs = (last ? HalHost::sleepingUs() : presses[i + 1].sleepingUs) - press.sleepingUs;
+        uint64_t const poweredDownUs = (last ? HalHost::poweredDownUs() : presses[i + 1].poweredDownUs) - press.poweredDownUs;
+
+        printf("press at %.3f ms, ", ms(press.downUs - startUs));
+        if (0 != press.upUs)
+        {
+            printf("held %.3f ms", ms(press.upUs - press.downUs));
+        }
+        else
+        {
+            printf("held until the end");
+        }
+        for (HalHost::LedEdge const & edge : ledEdges)
+        {
+            if (edge.on && (press.downUs <= edge.timeUs) && ((0 == press.upUs) || (edge.timeUs < press.upUs)))
+            {
+                printf(", long press after %.3f ms", ms(edge.timeUs - press.downUs));
+                break;
+            }
+        }
+        size_t count = 0;
+        uint64_t firstUs = 0;
+        uint64_t lastUs = 0;
+        for (HalHost::Report const & report : reports)
+        {
+            // A report releasing nothing [like the one at configuration] starts no message.
+            bool const empty = std::all_of(report.data, report.data + report.size, [](uint8_t b) { return 0 == b; });
+            if ((press.downUs <= report.timeUs) && (report.timeUs < untilUs) && ((0 != count) || !empty))
+            {
+                firstUs = (0 == count) ? report.timeUs : firstUs;
+                lastUs = report.timeUs;
+                ++count;
+            }
+        }
+        if (0 != count)
+        {
+            // Messages start at the release, cancelling happens while held.
+            bool const afterRelease = (0 != press.upUs) && (press.upUs <= firstUs);
+            uint64_t const fromUs = afterRelease ? press.upUs : press.downUs;
+            printf(", first report %.3f ms after %s, %zu reports until %.3f ms",
+                   ms(firstUs - fromUs), afterRelease ? "release" : "press", count, ms(lastUs - fromUs));
+        }
+        printf(", awake %.3f ms\n", ms(untilUs - press.downUs - sleepingUs - poweredDownUs));
+    }
+
+    for (uint64_t const configured : configuredUs)
+    {
+        printf("configured at %.3f ms", ms(configured - startUs));
+        for (HalHost::LedEdge const & edge : ledEdges)
+        {
+            if (!edge.on && (configured <= edge.timeUs))
+            {
+                printf(", host ready %.3f ms later", ms(edge.timeUs - configured));
+                break;
+            }
+        }
+        printf("\n");
+    }
+
+    uint64_t const totalUs = endUs - startUs;
+    uint64_t const awakeUs = totalUs - HalHost::sleepingUs() - HalHost::poweredDownUs();
+    printf("simulated %.3f ms: awake %.3f ms [%.1f%%], sleeping %.3f ms, powered down %.3f ms, %zu reports\n",
+           ms(totalUs), ms(awakeUs), (0 != totalUs) ? (100.0 * awakeUs / totalUs) : 0.0,
+           ms(HalHost::sleepingUs()), ms(HalHost::poweredDownUs()), reports.size());
+}
+
+int usage()
+{
+    fprintf(stderr, "Usage: simulateFirmware [--end-ms N] [--summary] [SCRIPT]\n");
+    return 2;
+}
+
+} // namespace
+
+
+int main(int argc, char ** argv)
+{
+    char const * fileName = nullptr;
+    unsigned long endMs = 0;
+    bool summaryOnly = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if ((0 == strcmp(argv[i], "--end-ms")) && (i + 1 < argc))
+        {
+            endMs = strtoul(argv[++i], nullptr, 0);
+        }
+        else if (0 == strcmp(argv[i], "--summary"))
+        {
+            summaryOnly = true;
+        }
+        else if ((nullptr == fileName) && ('-' != argv[i][0]))
+        {
+            fileName = argv[i];
+        }
+        else
+        {
+            return usage();
+        }
+    }
+
+    FILE * const file = (nullptr != fileName) ? fopen(fileName, "r") : stdin;
+    if (nullptr == file)
+    {
+        fprintf(stderr, "Cannot open %s\n", fileName);
+        return 1;
+    }
+
+    // Power-on.
+    HalHost::reset();
+    startUs = HalHost::nowUs();
+    unsigned long lastMs;
+    bool startConfigured;
+    bool const scheduled = schedule(file, (nullptr != fileName) ? fileName : "stdin", lastMs, startConfigured);
+    if (stdin != file)
+    {
+        fclose(file);
+    }
+    if (!scheduled)
+    {
+        return 1;
+    }
+    HalHost::setUsbConfigured(startConfigured);
+    uint64_t const endUs = startUs + ((0 != endMs) ? endMs : (lastMs + defaultTailMs)) * 1000ull;
+    HalHost::stopAt(endUs);
+
+    try
+    {
+        setup();
+    }
+    catch (HalHost::Stopped const &)
+    {
+        // the end of the script
+    }
+
+    if (!summaryOnly)
+    {
+        printTimeline();
+    }
+    printSummary(endUs);
+    return 0;
+}
@@ -0,0 +1,238 @@
+/*
+  typeText
+
+  Types text through Keyboard_ on the host build and prints every report
+  sent, with its virtual time stamp, followed by a summary.
+
+  Usage: typeText [--layout xx_YY] [--rollover] [--asynchronous]
+                  [--pacing fixed|drained|frames] [--delay-us N] [--frames N]
+                  [--utf8] [--unicode-input none|linux|windows]
+                  [--adaptive] [--host-latency-us N] [--macro]
+                  [--profile standard|fast|careful|bios] [text ...]
+
+  Without text arguments, stdin is typed. --utf8 types the text as UTF-8
+  [see Keyboard_::utf8] instead of KEY_* codes. --macro takes the text as
+  macro source [see MacroAssembler.h] and plays all its macros. --adaptive sets
+  Keyboard_::adaptiveRate, --host-latency-us how long the modelled host
+  takes to set its LEDs [see HalHost.h]. --profile sets Keyboard_::timing
+  [see TimingProfile.h] and its report delay, unless --delay-us is given.
+*/
+
+#include "HalHost.h"
+#include "Layouts.h"
+#include "Macro.h"
+#include "MacroAssembler.h"
+#include "SlowKeyboard.h"
+#include "TimingProfile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+
+static int usage()
+{
+    fprintf(stderr, "Usage: typeText [--layout xx_YY] [--rollover] [--asynchronous]\n"
+                    "                [--pacing fixed|drained|frames] [--delay-us N] [--frames N]\n"
+                    "                [--utf8] [--unicode-input none|linux|windows]\n"
+                    "                [--adaptive] [--host-latency-us N] [--macro]\n"
+                    "                [--profile standard|fast|careful|bios] [text ...]\n");
+    return 2;
+}
+
+int main(int argc, char ** argv)
+{
+    Keyboard_ & keyboard = Keyboard;
+    Layouts::NamedLayout const * layout = Layouts::find("en_US");
+    unsigned long hostLatencyUs = 2000;
+    bool delayGiven = false;
+    bool macro = false;
+    std::string text;
+    bool haveText = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        char const * const argument = argv[i];
+        bool const hasValue = (i + 1 < argc);
+        if ((0 == strcmp(argument, "--layout")) && hasValue)
+        {
+            layout = Layouts::find(argv[++i]);
+            if (nullptr == layout)
+            {
+                fprintf(stderr, "Unknown layout %s\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (0 == strcmp(argument, "--rollover"))
+        {
+            keyboard.rolloverTyping = true;
+        }
+        else if (0 == strcmp(argument, "--asynchronous"))
+        {
+            keyboard.asynchronous = true;
+        }
+        else if ((0 == strcmp(argument, "--pacing")) && hasValue)
+        {
+            char const * const pacing = argv[++i];
+            if (0 == strcmp(pacing, "fixed"))
+            {
+                keyboard.reportPacing = Keyboard_::ReportPacing::fixedDelay;
+            }
+            else if (0 == strcmp(pacing, "drained"))
+            {
+                keyboard.reportPacing = Keyboard_::ReportPacing::endpointDrained;
+            }
+            else if (0 == strcmp(pacing, "frames"))
+            {
+                keyboard.reportPacing = Keyboard_::ReportPacing::usbFrames;
+            }
+            else
+            {
+                return usage();
+            }
+        }
+        else if (0 == strcmp(argument, "--utf8"))
+        {
+            keyboard.utf8 = true;
+        }
+        else if ((0 == strcmp(argument, "--unicode-input")) && hasValue)
+        {
+            char const * const input = argv[++i];
+            if (0 == strcmp(input, "none"))
+            {
+                keyboard.unicodeInput = Keyboard_::UnicodeInput::none;
+            }
+            else if (0 == strcmp(input, "linux"))
+            {
+                keyboard.unicodeInput = Keyboard_::UnicodeInput::linuxCtrlShiftU;
+            }
+            else if (0 == strcmp(input, "windows"))
+            {
+                keyboard.unicodeInput = Keyboard_::UnicodeInput::windowsHexNumpad;
+            }
+            else
+            {
+                return usage();
+            }
+        }
+        else if ((0 == strcmp(argument, "--delay-us")) && hasValue)
+        {
+            keyboard.minimumReportDelayUs = strtoul(argv[++i], nullptr, 0);
+            delayGiven = true;
+        }
+        else if ((0 == strcmp(argument, "--frames")) && hasValue)
+        {
+            keyboard.framesPerReport = static_cast<uint8_t>(strtoul(argv[++i], nullptr, 0));
+        }
+        else if (0 == strcmp(argument, "--adaptive"))
+        {
+            keyboard.adaptiveRate = true;
+        }
+        else if ((0 == strcmp(argument, "--host-latency-us")) && hasValue)
+        {
+            hostLatencyUs = strtoul(argv[++i], nullptr, 0);
+        }
+        else if ((0 == strcmp(argument, "--profile")) && hasValue)
+        {
+            uint8_t const profile = TimingProfiles::find(argv[++i]);
+            if (TimingProfiles::count <= profile)
+            {
+                return usage();
+            }
+            keyboard.timing = TimingProfiles::get(profile);
+        }
+        else if (0 == strcmp(argument, "--macro"))
+        {
+            macro = true;
+        }
+        else if ('-' == argument[0])
+        {
+            return usage();
+        }
+        else
+        {
+            if (haveText)
+            {
+                text += ' ';
+            }
+            text += argument;
+            haveText = true;
+        }
+    }
+
+    // The profile's own report delay, unless one was given.
+    if (!delayGiven && (0 != keyboard.timing.reportDelayUs))
+    {
+        keyboard.minimumReportDelayUs = keyboard.timing.reportDelayUs;
+    }
+
+    if (!haveText)
+    {
+        int c;
+        while (EOF != (c = getchar()))
+        {
+            text += static_cast<char>(c);
+        }
+    }
+
+    std::vector<MacroAssembler::Entry> macros;
+    std::string error;
+    if (macro && !MacroAssembler::assemble(text, macros, error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    HalHost::reset();
+    HalHost::setHostLedLatencyUs(hostLatencyUs);
+    keyboard.begin(layout->table, layout->unicodeKeys, layout->unicodeKeyCount);
+    uint64_t const startUs = HalHost::nowUs();
+    size_t written = 0;
+    size_t length = text.size();
+    if (macro)
+    {
+        // Counts bytes of code instead of characters.
+        length = 0;
+        for (MacroAssembler::Entry const & entry : macros)
+        {
+            struct
+            {
+                std::vector<uint8_t> const & code;
+                size_t next;
+                int read()
+                {
+                    return (next < code.size()) ? code[next++] : -1;
+                }
+            } source = {entry.code, 0};
+            written += Macro::play(keyboard, source);
+            length += entry.code.size();
+        }
+    }
+    else
+    {
+        written = keyboard.write(reinterpret_cast<uint8_t const *>(text.data()), text.size());
+    }
+    keyboard.flush();
+    uint64_t const endUs = HalHost::nowUs();
+
+    for (HalHost::Report const & report : HalHost::reports())
+    {
+        printf("%10llu us  id %u ", static_cast<unsigned long long>(report.timeUs - startUs), report.id);
+        for (uint8_t i = 0; i < report.size; ++i)
+        {
+            printf(" %02x", report.data[i]);
+        }
+        printf("\n");
+    }
+    printf("%zu of %zu %s, %zu reports, %llu us\n",
+           written, length, macro ? "bytes" : "characters", HalHost::reports().size(), static_cast<unsigned long long>(endUs - startUs));
+    if (keyboard.adaptiveRate)
+    {
+        printf("host round trip %lu us, report delay %lu us\n", keyboard.hostRoundTripUs(), keyboard.minimumReportDelayUs);
+    }
+
+    return (written == length) ? 0 : 1;
+}
@@ -0,0 +1,538 @@
+/*
+  uploadMessages
+
+  Manages the messages in the EEPROM of the device over its serial port
+  [see MessageProtocol.h].
+
+  Usage: uploadMessages PORT list
+         uploadMessages PORT write ID FILE
+         uploadMessages PORT remove ID
+         uploadMessages PORT settings [NAME=VALUE ...]
+         uploadMessages PORT statistics [reset]
+         uploadMessages PORT trace [clear]
+         uploadMessages PORT cancel
+         uploadMessages PORT type FILE
+
+  FILE - reads the text from stdin. A written message is verified by
+  comparing the crc listed by the device. settings prints the settings
+  after changing the given ones [see Settings.h for the names]. statistics
+  needs firmware built with SLOW_KEYBOARD_STATISTICS, trace writes the
+  dump of a firmware built with SLOW_KEYBOARD_TRACE to stdout for
+  decodeTrace. cancel stops the message being typed. type streams the text
+  of FILE to the device, which types it as it arrives [see MessageUpload.h].
+*/
+
+#include "KeyboardStatistics.h"
+#include "MessageProtocol.h"
+#include "Settings.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <vector>
+
+
+using MessageProtocol::Command;
+using MessageProtocol::Status;
+
+namespace
+{
+
+struct Response
+{
+    Status status;
+    std::vector<uint8_t> payload;
+};
+
+// Writing takes about 3.4ms per EEPROM cell.
+unsigned long constexpr responseTimeoutMs = 2000;
+unsigned long constexpr timeoutPerByteMs = 4;
+
+// Text is typed in requests of this size, at up to two slow reports per byte.
+size_t constexpr typeChunkSize = 1024;
+unsigned long constexpr typeTimeoutPerByteMs = 250;
+
+int usage()
+{
+    fprintf(stderr, "Usage: uploadMessages PORT list\n"
+                    "       uploadMessages PORT write ID FILE\n"
+                    "       uploadMessages PORT remove ID\n"
+                    "       uploadMessages PORT settings [NAME=VALUE ...]\n"
+                    "       uploadMessages PORT statistics [reset]\n"
+                    "       uploadMessages PORT trace [clear]\n"
+                    "       uploadMessages PORT cancel\n"
+                    "       uploadMessages PORT type FILE\n");
+    return 2;
+}
+
+char const * statusName(Status status)
+{
+    switch (status)
+    {
+    case Status::ok:
+        return "ok";
+    case Status::badChecksum:
+        return "bad checksum";
+    case Status::unknownCommand:
+        return "unknown command";
+    case Status::badLength:
+        return "bad length";
+    case Status::noSpace:
+        return "no space";
+    case Status::notFound:
+        return "not found";
+    case Status::busy:
+        return "busy typing";
+    case Status::cancelled:
+        return "cancelled";
+    }
+    return "unknown status";
+}
+
+uint16_t crcOf(uint8_t const * data, size_t size, uint16_t crc = MessageProtocol::crcInitial)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc = MessageProtocol::crcUpdate(crc, data[i]);
+    }
+    return crc;
+}
+
+int openPort(char const * name)
+{
+    int const port = open(name, O_RDWR | O_NOCTTY);
+    if (port < 0)
+    {
+        fprintf(stderr, "Cannot open %s: %s\n", name, strerror(errno));
+        return -1;
+    }
+    termios settings;
+    if (0 == tcgetattr(port, &settings))
+    {
+        cfmakeraw(&settings);
+        tcsetattr(port, TCSANOW, &settings);
+    }
+    tcflush(port, TCIOFLUSH);
+    return port;
+}
+
+bool readFully(int port, uint8_t * data, size_t size, std::chrono::steady_clock::time_point deadline)
+{
+    while (0 < size)
+    {
+        long const leftMs = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        pollfd request = {port, POLLIN, 0};
+        if ((leftMs <= 0) || (poll(&request, 1, static_cast<int>(leftMs)) <= 0))
+        {
+            return false;
+        }
+        ssize_t const received = read(port, data, size);
+        if (received <= 0)
+        {
+            return false;
+        }
+        data += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+bool transfer(int port, Command command, std::vector<uint8_t> const & payload, Response & response,
+              unsigned long perByteMs = timeoutPerByteMs)
+{
+    std::vector<uint8_t> request = {MessageProtocol::sync,
+                                    static_cast<uint8_t>(command),
+                                    static_cast<uint8_t>(payload.size() & 0xff),
+                                    static_cast<uint8_t>(payload.size() >> 8)};
+    request.insert(request.end(), payload.begin(), payload.end());
+    uint16_t const crc = crcOf(request.data() + 1, request.size() - 1);
+    request.push_back(crc & 0xff);
+    request.push_back(crc >> 8);
+    if (static_cast<ssize_t>(request.size()) != write(port, request.data(), request.size()))
+    {
+        fprintf(stderr, "Cannot write request: %s\n", strerror(errno));
+        return false;
+    }
+
+    auto const deadline = std::chrono::steady_clock::now() +
+                          std::chrono::milliseconds(responseTimeoutMs + perByteMs * payload.size());
+    uint8_t header[5];
+    do
+    {
+        if (!readFully(port, header, 1, deadline))
+        {
+            fprintf(stderr, "No response\n");
+            return false;
+        }
+    }
+    while (MessageProtocol::sync != header[0]);
+    if (!readFully(port, header + 1, sizeof(header) - 1, deadline))
+    {
+        fprintf(stderr, "Incomplete response\n");
+        return false;
+    }
+    response.status = static_cast<Status>(header[2]);
+    response.payload.resize(header[3] | (header[4] << 8));
+    uint8_t received[2];
+    if (!readFully(port, response.payload.data(), response.payload.size(), deadline) ||
+        !readFully(port, received, sizeof(received), deadline))
+    {
+        fprintf(stderr, "Incomplete response\n");
+        return false;
+    }
+    uint16_t const expected = crcOf(response.payload.data(), response.payload.size(), crcOf(header + 1, sizeof(header) - 1));
+    if ((received[0] | (received[1] << 8)) != expected)
+    {
+        fprintf(stderr, "Response with bad checksum\n");
+        return false;
+    }
+    return true;
+}
+
+bool list(int port, bool print, uint8_t id, uint16_t & crc)
+{
+    Response response;
+    if (!transfer(port, Command::list, {}, response) || (Status::ok != response.status) || (response.payload.size() < 2))
+    {
+        return false;
+    }
+    std::vector<uint8_t> const & payload = response.payload;
+    if (print)
+    {
+        printf("%u bytes free\n", payload[0] | (payload[1] << 8));
+    }
+    bool found = false;
+    for (size_t i = 2; i + 5 <= payload.size(); i += 5)
+    {
+        unsigned const length = payload[i + 1] | (payload[i + 2] << 8);
+        unsigned const messageCrc = payload[i + 3] | (payload[i + 4] << 8);
+        if (print)
+        {
+            printf("message %3u: %4u bytes, crc %04x\n", payload[i], length, messageCrc);
+        }
+        if (id == payload[i])
+        {
+            crc = static_cast<uint16_t>(messageCrc);
+            found = true;
+        }
+    }
+    return print || found;
+}
+
+bool parseId(char const * text, uint8_t & id)
+{
+    char * end = nullptr;
+    unsigned long const value = strtoul(text, &end, 0);
+    if ((nullptr == end) || ('\0' != *end) || (0xfd < value))
+    {
+        fprintf(stderr, "Bad id %s [0 - 253]\n", text);
+        return false;
+    }
+    id = static_cast<uint8_t>(value);
+    return true;
+}
+
+struct SettingsField
+{
+    char const * name;
+    size_t offset;
+    size_t size;
+};
+
+SettingsField constexpr settingsFields[] = {{"messagesTyped", offsetof(Settings, messagesTyped), sizeof(Settings::messagesTyped)},
+                                            {"minimumReportDelayUs", offsetof(Settings, minimumReportDelayUs), sizeof(Settings::minimumReportDelayUs)},
+                                            {"messageIndex", offsetof(Settings, messageIndex), sizeof(Settings::messageIndex)},
+                                            {"layout", offsetof(Settings, layout), sizeof(Settings::layout)},
+                                            {"reportPacing", offsetof(Settings, reportPacing), sizeof(Settings::reportPacing)},
+                                            {"framesPerReport", offsetof(Settings, framesPerReport), sizeof(Settings::framesPerReport)},
+                                            {"rolloverTyping", offsetof(Settings, rolloverTyping), sizeof(Settings::rolloverTyping)},
+                                            {"unicodeInput", offsetof(Settings, unicodeInput), sizeof(Settings::unicodeInput)},
+                                            {"adaptiveRate", offsetof(Settings, adaptiveRate), sizeof(Settings::adaptiveRate)},
+                                            {"timingProfile", offsetof(Settings, timingProfile), sizeof(Settings::timingProfile)}};
+
+// Both the AVR and the host are little endian, so the fields can be accessed bytewise.
+unsigned long getField(Settings const & settings, SettingsField const & field)
+{
+    unsigned long value = 0;
+    memcpy(&value, reinterpret_cast<uint8_t const *>(&settings) + field.offset, field.size);
+    return value;
+}
+
+void setField(Settings & settings, SettingsField const & field, unsigned long value)
+{
+    memcpy(reinterpret_cast<uint8_t *>(&settings) + field.offset, &value, field.size);
+}
+
+bool changeSettings(Settings & settings, int count, char ** assignments)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        char const * const equals = strchr(assignments[i], '=');
+        SettingsField const * found = nullptr;
+        for (SettingsField const & field : settingsFields)
+        {
+            if ((nullptr != equals) && (strlen(field.name) == static_cast<size_t>(equals - assignments[i])) &&
+                (0 == strncmp(field.name, assignments[i], strlen(field.name))))
+            {
+                found = &field;
+            }
+        }
+        if (nullptr == found)
+        {
+            fprintf(stderr, "Bad setting %s\n", assignments[i]);
+            return false;
+        }
+        setField(settings, *found, strtoul(equals + 1, nullptr, 0));
+    }
+    return true;
+}
+
+void printHistogram(char const * name, KeyboardStatistics::Histogram const & histogram)
+{
+    unsigned long total = 0;
+    for (uint16_t count : histogram.counts)
+    {
+        total += count;
+    }
+    printf("%s: %lu", name, total);
+    if (histogram.minUs <= histogram.maxUs)
+    {
+        printf(", %luus - %luus [jitter %luus]", static_cast<unsigned long>(histogram.minUs),
+               static_cast<unsigned long>(histogram.maxUs), static_cast<unsigned long>(histogram.maxUs - histogram.minUs));
+    }
+    printf("\n");
+    for (uint8_t i = 0; i < KeyboardStatistics::bucketCount; ++i)
+    {
+        if (0 == histogram.counts[i])
+        {
+            continue;
+        }
+        if (KeyboardStatistics::bucketCount - 1 == i)
+        {
+            printf("  %6luus -         : %5u\n", static_cast<unsigned long>(KeyboardStatistics::bucketLowerUs(i)), histogram.counts[i]);
+        }
+        else
+        {
+            printf("  %6luus - %6luus: %5u\n", static_cast<unsigned long>(KeyboardStatistics::bucketLowerUs(i)),
+                   static_cast<unsigned long>(KeyboardStatistics::bucketLowerUs(i + 1)), histogram.counts[i]);
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    if (argc < 3)
+    {
+        return usage();
+    }
+    char const * const command = argv[2];
+
+    if ((0 == strcmp(command, "list")) && (3 == argc))
+    {
+        int const port = openPort(argv[1]);
+        uint16_t crc;
+        return ((0 <= port) && list(port, true, 0xff, crc)) ? 0 : 1;
+    }
+
+    if ((0 == strcmp(command, "write")) && (5 == argc))
+    {
+        uint8_t id;
+        if (!parseId(argv[3], id))
+        {
+            return 2;
+        }
+        FILE * const file = (0 == strcmp(argv[4], "-")) ? stdin : fopen(argv[4], "rb");
+        if (nullptr == file)
+        {
+            fprintf(stderr, "Cannot open %s\n", argv[4]);
+            return 1;
+        }
+        std::vector<uint8_t> payload = {id};
+        int c;
+        while (EOF != (c = fgetc(file)))
+        {
+            payload.push_back(static_cast<uint8_t>(c));
+        }
+        uint16_t const crc = crcOf(payload.data() + 1, payload.size() - 1);
+
+        int const port = openPort(argv[1]);
+        Response response;
+        if ((port < 0) || !transfer(port, Command::write, payload, response))
+        {
+            return 1;
+        }
+        if (Status::ok != response.status)
+        {
+            fprintf(stderr, "Write failed: %s\n", statusName(response.status));
+            return 1;
+        }
+        uint16_t stored = 0;
+        if (!list(port, false, id, stored) || (stored != crc))
+        {
+            fprintf(stderr, "Verification failed\n");
+            return 1;
+        }
+        printf("message %u: %zu bytes written\n", id, payload.size() - 1);
+        return 0;
+    }
+
+    if ((0 == strcmp(command, "remove")) && (4 == argc))
+    {
+        uint8_t id;
+        if (!parseId(argv[3], id))
+        {
+            return 2;
+        }
+        int const port = openPort(argv[1]);
+        Response response;
+        if ((port < 0) || !transfer(port, Command::remove, {id}, response))
+        {
+            return 1;
+        }
+        if (Status::ok != response.status)
+        {
+            fprintf(stderr, "Remove failed: %s\n", statusName(response.status));
+            return 1;
+        }
+        return 0;
+    }
+
+    if (0 == strcmp(command, "settings"))
+    {
+        int const port = openPort(argv[1]);
+        Response response;
+        if ((port < 0) || !transfer(port, Command::settings, {}, response) ||
+            (Status::ok != response.status) || (sizeof(Settings) != response.payload.size()))
+        {
+            fprintf(stderr, "Cannot read settings\n");
+            return 1;
+        }
+        Settings settings;
+        memcpy(&settings, response.payload.data(), sizeof(settings));
+        if (3 < argc)
+        {
+            if (!changeSettings(settings, argc - 3, argv + 3))
+            {
+                return 2;
+            }
+            uint8_t const * const bytes = reinterpret_cast<uint8_t const *>(&settings);
+            if (!transfer(port, Command::settings, std::vector<uint8_t>(bytes, bytes + sizeof(settings)), response) ||
+                (Status::ok != response.status) || (sizeof(Settings) != response.payload.size()))
+            {
+                fprintf(stderr, "Cannot write settings\n");
+                return 1;
+            }
+            memcpy(&settings, response.payload.data(), sizeof(settings));
+        }
+        for (SettingsField const & field : settingsFields)
+        {
+            printf("%s=%lu\n", field.name, getField(settings, field));
+        }
+        return 0;
+    }
+
+    if ((0 == strcmp(command, "statistics")) && ((3 == argc) || ((4 == argc) && (0 == strcmp(argv[3], "reset")))))
+    {
+        int const port = openPort(argv[1]);
+        Response response;
+        if ((port < 0) || !transfer(port, Command::statistics, (4 == argc) ? std::vector<uint8_t>{1} : std::vector<uint8_t>{}, response))
+        {
+            return 1;
+        }
+        if ((Status::ok != response.status) || (sizeof(KeyboardStatistics) != response.payload.size()))
+        {
+            fprintf(stderr, "Cannot read statistics: %s\n", statusName(response.status));
+            return 1;
+        }
+        KeyboardStatistics statistics;
+        memcpy(&statistics, response.payload.data(), sizeof(statistics));
+        printf("reports: %lu\ncharacters: %lu\n", static_cast<unsigned long>(statistics.reports),
+               static_cast<unsigned long>(statistics.characters));
+        printHistogram("wait", statistics.waitUs);
+        printHistogram("send", statistics.sendUs);
+        printHistogram("interval", statistics.intervalUs);
+        return 0;
+    }
+
+    if ((0 == strcmp(command, "trace")) && ((3 == argc) || ((4 == argc) && (0 == strcmp(argv[3], "clear")))))
+    {
+        int const port = openPort(argv[1]);
+        Response response;
+        if ((port < 0) || !transfer(port, Command::trace, (4 == argc) ? std::vector<uint8_t>{1} : std::vector<uint8_t>{}, response))
+        {
+            return 1;
+        }
+        if (Status::ok != response.status)
+        {
+            fprintf(stderr, "Cannot read trace: %s\n", statusName(response.status));
+            return 1;
+        }
+        fwrite(response.payload.data(), 1, response.payload.size(), stdout);
+        return 0;
+    }
+
+    if ((0 == strcmp(command, "type")) && (4 == argc))
+    {
+        FILE * const file = (0 == strcmp(argv[3], "-")) ? stdin : fopen(argv[3], "rb");
+        if (nullptr == file)
+        {
+            fprintf(stderr, "Cannot open %s\n", argv[3]);
+            return 1;
+        }
+        int const port = openPort(argv[1]);
+        if (port < 0)
+        {
+            return 1;
+        }
+        unsigned long total = 0;
+        std::vector<uint8_t> chunk(typeChunkSize);
+        size_t size;
+        while (0 < (size = fread(chunk.data(), 1, chunk.size(), file)))
+        {
+            chunk.resize(size);
+            Response response;
+            if (!transfer(port, Command::type, chunk, response, typeTimeoutPerByteMs))
+            {
+                return 1;
+            }
+            size_t const typed = (2 == response.payload.size()) ? (response.payload[0] | (response.payload[1] << 8)) : 0;
+            total += typed;
+            if ((Status::ok != response.status) || (typed != size))
+            {
+                fprintf(stderr, "Typing stopped after %lu bytes: %s\n", total,
+                        (Status::ok == response.status) ? "cannot type the next one" : statusName(response.status));
+                return 1;
+            }
+        }
+        printf("%lu bytes typed\n", total);
+        return 0;
+    }
+
+    if ((0 == strcmp(command, "cancel")) && (3 == argc))
+    {
+        int const port = openPort(argv[1]);
+        Response response;
+        if ((port < 0) || !transfer(port, Command::cancel, {}, response))
+        {
+            return 1;
+        }
+        if (Status::ok != response.status)
+        {
+            fprintf(stderr, "Cancel failed: %s\n", statusName(response.status));
+            return 1;
+        }
+        return 0;
+    }
+
+    return usage();
+}
@@ -0,0 +1,289 @@
+/*
+  verifyTyping
+
+  Checks that a host receives exactly the intended text: types it through
+  Keyboard_ on the host build [or takes the reports from a trace dump, see
+  decodeTrace], replays the reports through HostKeyboard and lists every
+  character dropped, duplicated, autorepeated or otherwise unexpected
+  [see TypingVerifier.h].
+
+  Usage: verifyTyping [--layout xx_YY] [--rollover] [--asynchronous]
+                      [--pacing fixed|drained|frames] [--delay-us N] [--frames N]
+                      [--utf8] [--unicode-input none|linux|windows]
+                      [--repeat-delay-ms N] [--repeat-rate N] [--trace FILE]
+                      [--adaptive] [--host-latency-us N]
+                      [--profile standard|fast|careful|bios] [text ...]
+
+  Without text arguments, stdin is the text. It is read as UTF-8 for the
+  comparison either way. --repeat-rate is in characters per second, the
+  defaults are the shortest common autorepeat settings [250ms, 30/s].
+  --adaptive, --host-latency-us and --profile are those of typeText. The exit code is
+  1 if there is any issue.
+*/
+
+#include "HalHost.h"
+#include "HostKeyboard.h"
+#include "KeyDecoder.h"
+#include "Layouts.h"
+#include "SlowKeyboard.h"
+#include "TimingProfile.h"
+#include "TraceDump.h"
+#include "TypingVerifier.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+
+static int usage()
+{
+    fprintf(stderr, "Usage: verifyTyping [--layout xx_YY] [--rollover] [--asynchronous]\n"
+                    "                    [--pacing fixed|drained|frames] [--delay-us N] [--frames N]\n"
+                    "                    [--utf8] [--unicode-input none|linux|windows]\n"
+                    "                    [--repeat-delay-ms N] [--repeat-rate N] [--trace FILE]\n"
+                    "                    [--adaptive] [--host-latency-us N]\n"
+                    "                    [--profile standard|fast|careful|bios] [text ...]\n");
+    return 2;
+}
+
+static std::string printable(uint32_t codePoint)
+{
+    switch (codePoint)
+    {
+    case '\n':
+        return "\\n";
+    case '\t':
+        return "\\t";
+    case '\b':
+        return "\\b";
+    }
+    std::string text;
+    KeyDecoder::appendUtf8(text, codePoint);
+    return text;
+}
+
+int main(int argc, char ** argv)
+{
+    Keyboard_ & keyboard = Keyboard;
+    Layouts::NamedLayout const * layout = Layouts::find("en_US");
+    HostKeyboard::Options options;
+    char const * traceName = nullptr;
+    unsigned long hostLatencyUs = 2000;
+    bool delayGiven = false;
+    std::string text;
+    bool haveText = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        char const * const argument = argv[i];
+        bool const hasValue = (i + 1 < argc);
+        if ((0 == strcmp(argument, "--layout")) && hasValue)
+        {
+            layout = Layouts::find(argv[++i]);
+            if (nullptr == layout)
+            {
+                fprintf(stderr, "Unknown layout %s\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (0 == strcmp(argument, "--rollover"))
+        {
+            keyboard.rolloverTyping = true;
+        }
+        else if (0 == strcmp(argument, "--asynchronous"))
+        {
+            keyboard.asynchronous = true;
+        }
+        else if ((0 == strcmp(argument, "--pacing")) && hasValue)
+        {
+            char const * const pacing = argv[++i];
+            if (0 == strcmp(pacing, "fixed"))
+            {
+                keyboard.reportPacing = Keyboard_::ReportPacing::fixedDelay;
+            }
+            else if (0 == strcmp(pacing, "drained"))
+            {
+                keyboard.reportPacing = Keyboard_::ReportPacing::endpointDrained;
+            }
+            else if (0 == strcmp(pacing, "frames"))
+            {
+                keyboard.reportPacing = Keyboard_::ReportPacing::usbFrames;
+            }
+            else
+            {
+                return usage();
+            }
+        }
+        else if (0 == strcmp(argument, "--utf8"))
+        {
+            keyboard.utf8 = true;
+        }
+        else if ((0 == strcmp(argument, "--unicode-input")) && hasValue)
+        {
+            char const * const input = argv[++i];
+            if (0 == strcmp(input, "none"))
+            {
+                keyboard.unicodeInput = Keyboard_::UnicodeInput::none;
+            }
+            else if (0 == strcmp(input, "linux"))
+            {
+                keyboard.unicodeInput = Keyboard_::UnicodeInput::linuxCtrlShiftU;
+            }
+            else if (0 == strcmp(input, "windows"))
+            {
+                keyboard.unicodeInput = Keyboard_::UnicodeInput::windowsHexNumpad;
+            }
+            else
+            {
+                return usage();
+            }
+            options.unicodeInput = keyboard.unicodeInput;
+        }
+        else if ((0 == strcmp(argument, "--delay-us")) && hasValue)
+        {
+            keyboard.minimumReportDelayUs = strtoul(argv[++i], nullptr, 0);
+            delayGiven = true;
+        }
+        else if ((0 == strcmp(argument, "--frames")) && hasValue)
+        {
+            keyboard.framesPerReport = static_cast<uint8_t>(strtoul(argv[++i], nullptr, 0));
+        }
+        else if ((0 == strcmp(argument, "--repeat-delay-ms")) && hasValue)
+        {
+            options.repeatDelayUs = 1000 * strtoul(argv[++i], nullptr, 0);
+        }
+        else if ((0 == strcmp(argument, "--repeat-rate")) && hasValue)
+        {
+            unsigned long const rate = strtoul(argv[++i], nullptr, 0);
+            if (0 == rate)
+            {
+                return usage();
+            }
+            options.repeatIntervalUs = 1000000 / rate;
+        }
+        else if ((0 == strcmp(argument, "--trace")) && hasValue)
+        {
+            traceName = argv[++i];
+        }
+        else if (0 == strcmp(argument, "--adaptive"))
+        {
+            keyboard.adaptiveRate = true;
+        }
+        else if ((0 == strcmp(argument, "--host-latency-us")) && hasValue)
+        {
+            hostLatencyUs = strtoul(argv[++i], nullptr, 0);
+        }
+        else if ((0 == strcmp(argument, "--profile")) && hasValue)
+        {
+            uint8_t const profile = TimingProfiles::find(argv[++i]);
+            if (TimingProfiles::count <= profile)
+            {
+                return usage();
+            }
+            keyboard.timing = TimingProfiles::get(profile);
+        }
+        else if ('-' == argument[0])
+        {
+            return usage();
+        }
+        else
+        {
+            if (haveText)
+            {
+                text += ' ';
+            }
+            text += argument;
+            haveText = true;
+        }
+    }
+
+    // The profile's own report delay, unless one was given.
+    if (!delayGiven && (0 != keyboard.timing.reportDelayUs))
+    {
+        keyboard.minimumReportDelayUs = keyboard.timing.reportDelayUs;
+    }
+
+    if (!haveText)
+    {
+        int c;
+        while (EOF != (c = getchar()))
+        {
+            text += static_cast<char>(c);
+        }
+    }
+
+    std::vector<TraceDump::Entry> reports;
+    if (nullptr != traceName)
+    {
+        FILE * const file = fopen(traceName, "rb");
+        if (nullptr == file)
+        {
+            fprintf(stderr, "Cannot open %s\n", traceName);
+            return 1;
+        }
+        std::vector<uint8_t> dump;
+        int c;
+        while (EOF != (c = fgetc(file)))
+        {
+            dump.push_back(static_cast<uint8_t>(c));
+        }
+        fclose(file);
+        if (!TraceDump::parse(dump, reports))
+        {
+            fprintf(stderr, "Not a trace dump\n");
+            return 1;
+        }
+    }
+    else
+    {
+        HalHost::reset();
+        HalHost::setHostLedLatencyUs(hostLatencyUs);
+        keyboard.begin(layout->table, layout->unicodeKeys, layout->unicodeKeyCount);
+        keyboard.write(reinterpret_cast<uint8_t const *>(text.data()), text.size());
+        keyboard.flush();
+        for (HalHost::Report const & report : HalHost::reports())
+        {
+            reports.push_back({report.timeUs, std::vector<uint8_t>(report.data, report.data + report.size)});
+        }
+    }
+
+    HostKeyboard host(*layout, options);
+    for (TraceDump::Entry const & report : reports)
+    {
+        host.report(report.timeUs, report.report.data(), report.report.size());
+    }
+    uint64_t const endUs = reports.empty() ? 0 : reports.back().timeUs;
+    bool const released = host.finish(endUs);
+
+    std::vector<uint32_t> expected;
+    for (uint32_t const codePoint : KeyDecoder::decodeUtf8(text))
+    {
+        if ('\r' != codePoint)  // not typed by Keyboard_::write()
+        {
+            expected.push_back(codePoint);
+        }
+    }
+    std::vector<TypingVerifier::Issue> const issues = TypingVerifier::compare(expected, host.characters());
+
+    for (TypingVerifier::Issue const & issue : issues)
+    {
+        printf("%-10s '%s' at character %zu", TypingVerifier::problemName(issue.problem),
+               printable(issue.codePoint).c_str(), issue.position);
+        if (TypingVerifier::Problem::dropped != issue.problem)
+        {
+            printf(", %.3f ms", issue.timeUs / 1000.0);
+        }
+        printf("\n");
+    }
+    if (!released)
+    {
+        printf("keys still held after the last report\n");
+    }
+    printf("%zu characters expected, %zu received from %zu reports [%zu ignored], %zu issues\n",
+           expected.size(), host.characters().size(), reports.size(), host.ignoredReports(), issues.size());
+
+    return (issues.empty() && released && (0 == host.ignoredReports())) ? 0 : 1;
+}
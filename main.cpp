@@ -5,9 +5,17 @@
   connected USB host.
 
   The message to be sent can be selected by long-pressing the button
-  and afterwards cycling through them with normal button presses [starting
-  from the first one].
+  and afterwards pressing it once per message number [starting from the
+  first one, see Button.h for the gestures].
   The selected message number will be remembered even when powered off.
+  Messages uploaded over the serial port [see MessageProtocol.h] replace
+  the built-in ones with the same number or add new ones. Messages are
+  macros [see Macro.h], so besides text they may press special keys and
+  chords or wait - host/assembleMacros writes them. Pressing the button
+  while a message is typed [or uploadMessages PORT cancel] stops it.
+  uploadMessages PORT type FILE types any amount of text sent over serial.
+  The LED is on from power-on until the host is ready for input - a
+  message requested before then is typed right afterwards.
 
   The circuit:
   Lily TTGO USB with button between MISO and GND [see drawing.svg].
@@ -16,14 +24,17 @@
 */
 
 
+#include "Button.h"
+#include "CompressedMessage.h"
+#include "EepromMessages.h"
+#include "Hal.h"
+#include "Macro.h"
+#include "MessageUpload.h"
+#include "Settings.h"
+#include "SettingsStore.h"
 #include "SlowKeyboard.h"
 
 #include <Arduino.h>
-#include <EEPROM.h>
-#include <Wire.h>
-
-#include <avr/pgmspace.h>
-#include <avr/sleep.h>
 
 #include <string.h>
 
@@ -31,212 +42,363 @@
 namespace Messages
 {
 
-typedef void (*KeyboardFunction)(Keyboard_ & keyboard);
+// Layouts of the host the messages are typed into, selected by Settings::layout.
+static constexpr uint8_t const * layouts[] = {KeyboardLayout_de_DE,
+                                              KeyboardLayout_en_US,
+                                              KeyboardLayout_es_ES,
+                                              KeyboardLayout_fr_FR,
+                                              KeyboardLayout_it_IT};
 
-void keyboardFunction0(Keyboard_ & keyboard)
+// The characters beyond ASCII each of the layouts types [see KeyboardLayout.h].
+struct UnicodeTable
 {
-    keyboard.print(F("String 0"));
-    keyboard.write(KEY_RETURN);
-}
+    UnicodeKey const * keys;
+    uint8_t count;
+};
 
-void keyboardFunction1(Keyboard_ & keyboard)
+template <size_t N>
+constexpr UnicodeTable unicodeTable(UnicodeKey const (&keys)[N])
 {
-    keyboard.print(F("String 1"));
-    keyboard.write(KEY_RETURN);
+    return {keys, N};
 }
 
-void keyboardFunction2(Keyboard_ & keyboard)
-{
-    keyboard.print(F("String 2"));
-    keyboard.write(KEY_RETURN);
-}
+static constexpr UnicodeTable unicodeTables[] = {unicodeTable(KeyboardLayout_de_DE_unicode),
+                                                 {nullptr, 0},
+                                                 unicodeTable(KeyboardLayout_es_ES_unicode),
+                                                 unicodeTable(KeyboardLayout_fr_FR_unicode),
+                                                 unicodeTable(KeyboardLayout_it_IT_unicode)};
+static_assert(sizeof(layouts) / sizeof(layouts[0]) == sizeof(unicodeTables) / sizeof(unicodeTables[0]),
+              "a unicode table per layout");
+
+// All messages, compressed into flash [see CompressedMessage.h] and
+// checked against all layouts [see Macro.h]. Paste the output of
+// host/assembleMacros here for more than text.
+static constexpr auto store PROGMEM = KEYBOARD_COMPRESS_MACROS(layouts, unicodeTables,
+    "String 0\n",
+    "String 1\n",
+    "String 2\n",
+    "String 3\n",
+    "String 4\n",
+    "String 5\n");
+
+static size_t constexpr count = store.count;
 
-void keyboardFunction3(Keyboard_ & keyboard)
-{
-    keyboard.print(F("String 3"));
-    keyboard.write(KEY_RETURN);
-}
+} // namespace Messages
 
-void keyboardFunction4(Keyboard_ & keyboard)
+namespace EepromAddresses
 {
-    keyboard.print(F("String 4"));
-    keyboard.write(KEY_RETURN);
-}
 
-void keyboardFunction5(Keyboard_ & keyboard)
-{
-    keyboard.print(F("String 5"));
-    keyboard.write(KEY_RETURN);
-}
+// The settings log and the uploaded messages each have their own area.
+static size_t constexpr settingsBegin = 0;
+static size_t constexpr settingsEnd = 256;
+static size_t constexpr messagesBegin = settingsEnd;
+static size_t constexpr messagesEnd = Hal::eepromSize;
+
+// Where firmware before the settings log kept the selected message index [a size_t].
+static size_t constexpr legacyMessageIndex = 0;
 
-KeyboardFunction constexpr array[] = {keyboardFunction0,
-                                      keyboardFunction1,
-                                      keyboardFunction2,
-                                      keyboardFunction3,
-                                      keyboardFunction4,
-                                      keyboardFunction5};
+} // namespace EepromAddresses
 
-static size_t constexpr count = sizeof(array) / sizeof(array[0]);
 
-} // namespace Messages
+static Keyboard_ & slowKeyboard = Keyboard;
 
-namespace Pins
-{
+static Settings settings = defaultSettings;
+static SettingsStore settingsStore(EepromAddresses::settingsBegin, EepromAddresses::settingsEnd, sizeof(Settings));
 
-static uint8_t constexpr button = PIN_SPI_MISO; // PE6, Int4
-static uint8_t constexpr led = LED_BUILTIN;
+static EepromMessages eepromMessages(EepromAddresses::messagesBegin, EepromAddresses::messagesEnd);
+static MessageUpload messageUpload(eepromMessages, settings, settingsStore);
 
-} // namespace Pin
 
-namespace EepromAddresses
+// Selecting a message ends this long after the last button press.
+static unsigned long constexpr selectionTimeoutMs = 2000;
+
+static bool selecting = false;
+// The long press starting a selection is still held.
+static bool longPressHeld = false;
+
+// The host is ready for input once it configured the device and its HID
+// driver polls the keyboard endpoint - it fetches the report releasing all
+// keys sent after configuration then. Hosts which never poll before there
+// is input get it after hostReadyTimeoutMs.
+enum class HostState : uint8_t
 {
+    unconfigured,
+    configured,
+    ready
+};
+static HostState hostState = HostState::unconfigured;
+static unsigned long hostConfiguredMs = 0;
+static unsigned long constexpr hostReadyTimeoutMs = 1000;
+
+// A message requested before the host is ready or while it suspended the
+// bus waits for it [woken by remote wakeup], instead of being typed into
+// nowhere - but not longer than messagePendingTimeoutMs, so it does not
+// end up in whatever has the focus much later. A dropped request
+// [also if the host does not allow remote wakeup] flashes the LED.
+static bool messagePending = false;
+static unsigned long messagePendingMs = 0;
+static unsigned long constexpr messagePendingTimeoutMs = 5000;
+// The host may ignore input for this long after resuming [TRSMRCY].
+static unsigned long constexpr resumeRecoveryMs = 10;
+static bool wokeHost = false;
+
+// The button press which cancelled a message is no gesture of its own.
+static bool ignoreGesture = false;
 
-static uint8_t constexpr selectedMessageIndex = 0;
 
-} // namespace EepromAddresses
+void enterSleepMode(void)
+{
+    if (Button.idle() && !selecting && !messageUpload.busy() && !messagePending && (HostState::configured != hostState))
+    {
+        Hal::powerDown();
+    }
+    else
+    {
+        Hal::sleep(); // keep millis() running for the pending timeouts
+    }
+}
 
+size_t messageCount()
+{
+    size_t const stored = eepromMessages.idLimit();
+    return (Messages::count < stored) ? stored : Messages::count;
+}
 
-static Keyboard_ & slowKeyboard = Keyboard;
+// applySettings() configures the keyboard from settings [which may change over serial].
+void applySettings()
+{
+    size_t constexpr layoutCount = sizeof(Messages::layouts) / sizeof(Messages::layouts[0]);
+    uint8_t const layout = (layoutCount > settings.layout) ? settings.layout : 0;
+    slowKeyboard.begin(Messages::layouts[layout], Messages::unicodeTables[layout].keys, Messages::unicodeTables[layout].count);
+    slowKeyboard.minimumReportDelayUs = settings.minimumReportDelayUs;
+    slowKeyboard.reportPacing = (static_cast<uint8_t>(Keyboard_::ReportPacing::usbFrames) >= settings.reportPacing)
+                                ? static_cast<Keyboard_::ReportPacing>(settings.reportPacing)
+                                : Keyboard_::ReportPacing::fixedDelay;
+    slowKeyboard.framesPerReport = settings.framesPerReport;
+    slowKeyboard.rolloverTyping = (0 != settings.rolloverTyping);
+    slowKeyboard.adaptiveRate = (0 != settings.adaptiveRate);
+    slowKeyboard.unicodeInput = (static_cast<uint8_t>(Keyboard_::UnicodeInput::windowsHexNumpad) >= settings.unicodeInput)
+                                ? static_cast<Keyboard_::UnicodeInput>(settings.unicodeInput)
+                                : Keyboard_::UnicodeInput::none;
+    slowKeyboard.timing = TimingProfiles::get(settings.timingProfile);
+    if (0 != slowKeyboard.timing.reportDelayUs)
+    {
+        slowKeyboard.minimumReportDelayUs = slowKeyboard.timing.reportDelayUs;
+    }
+}
 
-static bool volatile buttonPressed = false;
+void typeMessage(size_t index)
+{
+    EepromMessages::Reader stored;
+    if ((EepromMessages::maximumId >= index) && eepromMessages.find(static_cast<uint8_t>(index), stored))
+    {
+        Macro::play(slowKeyboard, stored);
+    }
+    else if (Messages::count > index)
+    {
+        CompressedMessage::Reader message(Messages::store.message(index));
+        Macro::play(slowKeyboard, message);
+    }
+}
 
-static size_t messageIndex = 0;
+// updateHostState() follows the host through enumeration [and bus resets],
+// with the LED on until it is ready.
+void updateHostState()
+{
+    if (!Hal::usbConfigured())
+    {
+        if (HostState::unconfigured != hostState)
+        {
+            hostState = HostState::unconfigured;
+            Hal::setLed(true);
+        }
+    }
+    else if (HostState::unconfigured == hostState)
+    {
+        hostState = HostState::configured;
+        hostConfiguredMs = Hal::millis();
+        slowKeyboard.releaseAll();
+        slowKeyboard.flush();
+    }
+    else if ((HostState::configured == hostState) &&
+             (Hal::keyboardEndpointDrained() || (hostReadyTimeoutMs <= (Hal::millis() - hostConfiguredMs))))
+    {
+        hostState = HostState::ready;
+        Hal::setLed(selecting);
+    }
+}
 
+// dropMessageRequest() forgets the pending message and flashes the LED three times.
+void dropMessageRequest()
+{
+    messagePending = false;
+    wokeHost = false;
+    for (uint8_t i = 0; i < 3; ++i)
+    {
+        Hal::setLed(true);
+        Hal::delay(150);
+        Hal::setLed(false);
+        Hal::delay(150);
+    }
+    Hal::setLed(selecting || (HostState::ready != hostState));
+}
 
-ISR(PCINT0_vect)
+// whileTyping() cancels the message on a button press or a cancel request
+// over serial [see Keyboard_::whileWaiting].
+void whileTyping()
 {
-    PCICR &= ~PCIE0; // Disable pin change interrupt for PCINT7..0 of Atmega 32u4.
+    if (Hal::buttonDown() && !slowKeyboard.cancelled())
+    {
+        slowKeyboard.cancel();
+        ignoreGesture = true;
+    }
+    messageUpload.pollWhileTyping();
 }
 
-void enterSleepMode(void)
+// typeSelectedMessage() types the selected message and counts it unless cancelled.
+void typeSelectedMessage()
 {
-    static_assert(PIN_SPI_MISO == Pins::button); // Make sure we are talking about the same pin here and everywhere else.
-    PCIFR |= PCIF0; // Clear interrupt flag for PCINT7..0 of Atmega 32u4.
-    PCICR |= PCIE0; // Enable pin change interrupt for PCINT7..0 of Atmega 32u4.
-    set_sleep_mode(SLEEP_MODE_IDLE);
-    sleep_enable();
-    sleep_mode();
-    sleep_disable();
+    applySettings();
+    typeMessage(settings.messageIndex);
+    // Release the last key in case rolloverTyping held it [or all keys if
+    // cancelled] and wait [sleeping] for asynchronous reports to be sent.
+    slowKeyboard.flush();
+
+    if (!slowKeyboard.cancelled())
+    {
+        ++settings.messagesTyped;
+        settingsStore.save(&settings);
+    }
 }
 
+
 void setup()
 {
-    PCMSK0 = PCINT3; // Enable pin change interrupt for PB3 [Arduino Pin PIN_SPI_MISO].
-    pinMode(Pins::button, INPUT_PULLUP);
-    pinMode(Pins::led, OUTPUT);
+    Hal::initPins();
+    Hal::beginSerial();
 
-    EEPROM.get(EepromAddresses::selectedMessageIndex, messageIndex);
-    if (Messages::count <= messageIndex)
+    if (!settingsStore.load(&settings))
+    {
+        // Keep the selection of older firmware until the first save() overwrites it.
+        size_t index = 0;
+        Hal::getEeprom(EepromAddresses::legacyMessageIndex, index);
+        settings.messageIndex = (messageCount() > index) ? static_cast<uint8_t>(index) : 0;
+    }
+    if (messageCount() <= settings.messageIndex)
     {
-        messageIndex = 0;
+        settings.messageIndex = 0;
     }
 
-    // initialize control over the keyboard:
-//    slowKeyboard.minimumReportDelayUs = 8000;
+    // initialize control over the keyboard [layout and pacing come from settings]:
+//    slowKeyboard.asynchronous = true;
+
+    applySettings();
+    slowKeyboard.whileWaiting = whileTyping;
+    messageUpload.prepareKeyboard = applySettings;
 
-    slowKeyboard.begin(KeyboardLayout_de_DE);
+    // The LED stays on until the host is ready [see updateHostState()].
+    Hal::setLed(true);
 
-    digitalWrite(Pins::led, HIGH);
-    // Wait for the USB connection to become operational.
-    delay(600);
-    digitalWrite(Pins::led, LOW);
+    Button.begin();
 
     while (true)
     {
-        buttonPressed = (LOW == digitalRead(Pins::button));
+        updateHostState();
 
-        if (buttonPressed)
+        Button_::Event event = Button.update(Hal::millis());
+        if (ignoreGesture)
         {
-            bool longPress = false;
+            // Ends with its gesture, or with the edges it left if it was over while typing.
+            if ((Button_::Gesture::none != event.gesture) || Button.idle())
             {
-                unsigned long const timePressed = millis();
-                delay(50); // debounce
-
-                // Wait for the button to be released.
-                while (LOW == digitalRead(Pins::button))
-                {
-                    unsigned long const now = millis();
-                    // If the button is held low for more than 250ms consider it a long press.
-                    if (250 < (now - timePressed))
-                    {
-                        longPress = true;
-                        digitalWrite(Pins::led, HIGH);
-                    }
-                }
+                ignoreGesture = false;
             }
+            event.gesture = Button_::Gesture::none;
+        }
 
-            if (longPress)
+        if (selecting)
+        {
+            if (Button_::Gesture::shortPress == event.gesture)
             {
-                // Update the selected message index.
-
-                unsigned long constexpr timeout = 2000; // milliseconds
-                bool timedOut = false;
-                size_t buttonPresses = 0;
+                // Change to zero-based index and confine to available number of messages.
+                settings.messageIndex = (event.count - 1) % messageCount();
+                // Remember the selection even after power off.
+                settingsStore.save(&settings);
+                selecting = false;
+            }
+            else if (Button.idle() && (selectionTimeoutMs < (Hal::millis() - Button.lastChangeMs())))
+            {
+                selecting = false; // no presses, keep the selection
+            }
 
-                do
+            if (!selecting)
+            {
+                Button.multiPressGapMs = 0;
+            }
+            if (!Button.down())
+            {
+                longPressHeld = false;
+            }
+            // LED on while selecting, off while a counted press is held [on until the host is ready].
+            Hal::setLed((selecting && (longPressHeld || !Button.down())) || (HostState::ready != hostState));
+        }
+        else if (Button_::Gesture::longPress == event.gesture)
+        {
+            // Count the following presses to select a message.
+            selecting = true;
+            longPressHeld = true;
+            Button.multiPressGapMs = selectionTimeoutMs;
+            Hal::setLed(true);
+        }
+        else if (Button_::Gesture::shortPress == event.gesture)
+        {
+            // write out the message for a short press of the button
+            if (HostState::ready != hostState)
+            {
+                messagePending = true;
+                messagePendingMs = Hal::millis();
+            }
+            else if (Hal::usbSuspended())
+            {
+                if (Hal::wakeupHost())
                 {
-                    {
-                        // check whether pressed again
-                        unsigned long const timeReleased = millis();
-                        delay(50); // debounce
-                        while ((HIGH == digitalRead(Pins::button)) && !timedOut)
-                        {
-                            if (timeout < (millis() - timeReleased))
-                            {
-                                timedOut = true;
-                            }
-                        }
-                    }
-
-                    if (!timedOut)
-                    {
-                        // wait to be released again
-                        unsigned long const timePressed = millis();
-                        digitalWrite(Pins::led, LOW); // Turn off LED temporarily when pressed.
-                        delay(50); // debounce
-                        while ((LOW == digitalRead(Pins::button)))
-                        {
-                            // Turn LED back on after 500ms.
-                            if (500 < (millis() - timePressed))
-                            {
-                                digitalWrite(Pins::led, HIGH);
-                            }
-                        }
-                        digitalWrite(Pins::led, HIGH);
-
-                        // Note button press.
-                        // Please note that this will overflow ungracefully, so don't press the button more
-                        // than std::numeric_limits<size_t>::max() times, i.e. 65535 for 16-bit.
-                        buttonPresses += 1;
-                    }
+                    messagePending = true;
+                    messagePendingMs = Hal::millis();
+                    wokeHost = true;
                 }
-                while (!timedOut);
-
-                digitalWrite(Pins::led, LOW); // Selection finished, so turn off LED again.
-
-                if (0 < buttonPresses)
+                else
                 {
-                    // Change to zero-based index and confine to available number of messages..
-                    messageIndex = (buttonPresses - 1) % Messages::count;
-                    // Remember messageIndex even after power off.
-                    EEPROM.put(EepromAddresses::selectedMessageIndex, messageIndex);
+                    dropMessageRequest();
                 }
             }
             else
             {
-                // write out the message for a short press of the button
-                Messages::array[messageIndex](slowKeyboard);
+                typeSelectedMessage();
             }
+        }
 
-            buttonPressed = false;
+        if (messagePending && (HostState::ready == hostState) && !Hal::usbSuspended())
+        {
+            messagePending = false;
+            if (wokeHost)
+            {
+                wokeHost = false;
+                Hal::delay(resumeRecoveryMs);
+            }
+            typeSelectedMessage();
         }
-        else
+        else if (messagePending && (messagePendingTimeoutMs <= (Hal::millis() - messagePendingMs)))
         {
-            // intentionally empty
+            dropMessageRequest();
         }
-        
+
+        messageUpload.poll();
+
         // Conserve power by going to sleep now.
-        enterSleepMode();
+        if (Button_::Gesture::none == event.gesture)
+        {
+            enterSleepMode();
+        }
     }
 
     // finalize
@@ -246,8 +408,8 @@ void setup()
 void loop()
 {
     // notify error condition
-    digitalWrite(Pins::led, HIGH);
-    delay(500);
-    digitalWrite (Pins::led, LOW);
-    delay(500);
+    Hal::setLed(true);
+    Hal::delay(500);
+    Hal::setLed(false);
+    Hal::delay(500);
 }